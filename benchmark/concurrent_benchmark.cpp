@@ -0,0 +1,187 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../my_map/my_concurrent_map.cpp"
+#include "../my_map/my_sharded_map.cpp"
+
+/** Runs 'readers' threads, each performing 'lookups' lookups of random keys through 'lookup', while one writer thread keeps calling 'update'.
+* Half of the looked up keys are present. Returns the total number of lookups per second.
+* @param unsigned readers - the number of reader threads
+* @param size_t lookups - the number of lookups of every reader
+* @param size_t number_of_keys - the number of keys in the map, which are the even numbers below 2 * number_of_keys
+* @param lookup_type lookup - callable taking an int key and returning bool
+* @param update_type update - callable taking an int key, performing a single write
+* @param size_t& writes - receives the number of writes performed during the measurement
+* @return lookups per second
+*/
+template <class lookup_type, class update_type>
+double measure_readers(unsigned readers, size_t lookups, size_t number_of_keys, lookup_type lookup, update_type update, size_t& writes)
+{
+	std::atomic<bool> start{ false }, done{ false };
+	std::atomic<size_t> hits{ 0 };
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < readers; ++t)
+		threads.emplace_back([&, t]()
+			{
+				std::mt19937 generator(t + 1);
+				std::uniform_int_distribution<int> keys(0, int(2 * number_of_keys - 1));
+				size_t found = 0;
+				while (not start.load())
+					std::this_thread::yield();
+				for (size_t i = 0; i < lookups; ++i)
+					found += lookup(keys(generator)) ? 1 : 0;
+				hits += found;
+			});
+	std::thread writer([&]()
+		{
+			std::mt19937 generator(0);
+			std::uniform_int_distribution<int> keys(0, int(number_of_keys - 1));
+			size_t count = 0;
+			while (not start.load())
+				std::this_thread::yield();
+			while (not done.load())
+			{
+				update(2 * keys(generator) + 1);
+				++count;
+			}
+			writes = count;
+		});
+	auto begin = std::chrono::steady_clock::now();
+	start = true;
+	for (std::thread& thread : threads)
+		thread.join();
+	auto end = std::chrono::steady_clock::now();
+	done = true;
+	writer.join();
+	return double(readers) * lookups / std::chrono::duration<double>(end - begin).count();
+}
+
+/** Compares the lookup throughput of my_concurrent_map with my_map guarded by a global mutex, for 1, 2, 4, ... reader threads
+* and one writer thread alternately inserting and erasing keys that are not looked up.
+* @param size_t number_of_keys - the number of keys in the maps
+* @param size_t lookups - the number of lookups of every reader thread
+* @param unsigned max_readers - the greatest number of reader threads
+* @return void
+*/
+inline void concurrent_benchmark(size_t number_of_keys, size_t lookups, unsigned max_readers)
+{
+	my_concurrent_map<int, int> concurrent;
+	my_map<int, int> locked;
+	std::mutex lock;
+	concurrent.write([&](my_map<int, int>& map)
+		{
+			for (size_t i = 0; i < number_of_keys; ++i)
+				map.insert(std::make_pair(int(2 * i), int(i)));
+		});
+	for (size_t i = 0; i < number_of_keys; ++i)
+		locked.insert(std::make_pair(int(2 * i), int(i)));
+
+	std::cout << "concurrent lookups, " << number_of_keys << " keys, one writer" << std::endl;
+	std::cout << std::setw(8) << "readers" << std::setw(20) << "left-right Mops/s" << std::setw(12) << "writes"
+		<< std::setw(20) << "mutex Mops/s" << std::setw(12) << "writes" << std::endl;
+	for (unsigned readers = 1; readers <= max_readers; readers *= 2)
+	{
+		size_t concurrent_writes = 0, locked_writes = 0;
+		double concurrent_rate = measure_readers(readers, lookups, number_of_keys,
+			[&](int key) { return concurrent.contains(key); },
+			[&](int key)
+			{
+				if (concurrent.contains(key))
+					concurrent.erase(key);
+				else
+					concurrent.insert(std::make_pair(key, key));
+			},
+			concurrent_writes);
+		double locked_rate = measure_readers(readers, lookups, number_of_keys,
+			[&](int key)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				return locked.contains(key);
+			},
+			[&](int key)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (locked.contains(key))
+					locked.erase(key);
+				else
+					locked.insert(std::make_pair(key, key));
+			},
+			locked_writes);
+		std::cout << std::setw(8) << readers << std::setw(20) << std::fixed << std::setprecision(2) << concurrent_rate / 1e6
+			<< std::setw(12) << concurrent_writes << std::setw(20) << locked_rate / 1e6 << std::setw(12) << locked_writes << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+/** Runs 'writers' threads, each performing 'inserts' insertions of random keys below 'key_range' through 'insert'. Returns the total number of insertions per second.
+* @param unsigned writers - the number of writer threads
+* @param size_t inserts - the number of insertions of every writer
+* @param int key_range - the bound of the keys
+* @param insert_type insert - callable taking an int key, performing a single insertion
+* @return insertions per second
+*/
+template <class insert_type>
+double measure_writers(unsigned writers, size_t inserts, int key_range, insert_type insert)
+{
+	std::atomic<bool> start{ false };
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < writers; ++t)
+		threads.emplace_back([&, t]()
+			{
+				std::mt19937 generator(t + 1);
+				std::uniform_int_distribution<int> keys(0, key_range - 1);
+				while (not start.load())
+					std::this_thread::yield();
+				for (size_t i = 0; i < inserts; ++i)
+					insert(keys(generator));
+			});
+	auto begin = std::chrono::steady_clock::now();
+	start = true;
+	for (std::thread& thread : threads)
+		thread.join();
+	return double(writers) * inserts / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/** Compares the insertion throughput of my_sharded_map, partitioned by a sample of the keys into four shards per thread of the largest run,
+* with my_map guarded by a global mutex, for 1, 2, 4, ... writer threads inserting random keys into fresh maps.
+* @param size_t inserts - the number of insertions of every writer thread
+* @param unsigned max_writers - the greatest number of writer threads
+* @return void
+*/
+inline void sharded_benchmark(size_t inserts, unsigned max_writers)
+{
+	const int key_range = 1 << 30;
+	std::vector<int> sample;
+	std::mt19937 generator(0);
+	std::uniform_int_distribution<int> keys(0, key_range - 1);
+	for (size_t i = 0; i < 4096; ++i)
+		sample.push_back(keys(generator));
+
+	std::cout << "concurrent inserts, " << inserts << " per writer" << std::endl;
+	std::cout << std::setw(8) << "writers" << std::setw(18) << "sharded Mops/s" << std::setw(10) << "shards"
+		<< std::setw(18) << "mutex Mops/s" << std::endl;
+	for (unsigned writers = 1; writers <= max_writers; writers *= 2)
+	{
+		my_sharded_map<int, int> sharded(sample.begin(), sample.end(), 4 * size_t(max_writers));
+		double sharded_rate = measure_writers(writers, inserts, key_range,
+			[&](int key) { sharded.insert(std::make_pair(key, key)); });
+		my_map<int, int> locked;
+		std::mutex lock;
+		double locked_rate = measure_writers(writers, inserts, key_range,
+			[&](int key)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				locked.insert(std::make_pair(key, key));
+			});
+		std::cout << std::setw(8) << writers << std::setw(18) << std::fixed << std::setprecision(2) << sharded_rate / 1e6
+			<< std::setw(10) << sharded.number_of_shards() << std::setw(18) << locked_rate / 1e6 << std::endl;
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,74 @@
+#include "concurrent_benchmark.cpp"
+#include "map_benchmark.cpp"
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// The global allocation functions are replaced to count the allocations made by the measured containers and the bytes they hold.
+// The bytes of a block are those the C allocator reports for it, so that the unsized 'operator delete' can account for them too.
+// The replacements have to be defined in exactly one translation unit. 'operator delete' is kept out of line, since GCC would otherwise
+// inline it into its callers and take its 'free' for a mismatch with 'operator new'.
+#if defined(__GNUC__) || defined(__clang__)
+#define OUT_OF_LINE __attribute__((noinline))
+#else
+#define OUT_OF_LINE
+#endif
+
+/** Returns the usable size of a block obtained from malloc, which is at least the requested size.
+* @param void* block - the block
+* @return the size in bytes
+*/
+inline size_t block_size(void* block)
+{
+#ifdef _WIN32
+	return _msize(block);
+#elif defined(__APPLE__)
+	return malloc_size(block);
+#else
+	return malloc_usable_size(block);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	++allocation_count;
+	allocated_bytes += size;
+	if (void* block = std::malloc(size == 0 ? 1 : size))
+	{
+		live_bytes += block_size(block);
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+OUT_OF_LINE void operator delete(void* pointer) noexcept
+{
+	if (pointer == nullptr)
+		return;
+	live_bytes -= block_size(pointer);
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	operator delete(pointer);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t max_elements = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	map_benchmark(max_elements);
+	unsigned cores = std::thread::hardware_concurrency();
+	concurrent_benchmark(1000000, 2000000, cores == 0 ? 4 : cores);
+	sharded_benchmark(500000, cores == 0 ? 4 : cores);
+	return 0;
+}
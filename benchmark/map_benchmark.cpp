@@ -0,0 +1,569 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../my_map/my_btree.cpp"
+#include "../my_map/my_durable_map.cpp"
+#include "../my_map/my_map.cpp"
+
+/// Counters of the global allocation functions, which are replaced in main.cpp. Not reset between measurements; read the differences.
+/// 'live_bytes' also goes down on deallocation, so its difference over a measurement is the memory the container holds at its end.
+inline std::atomic<size_t> allocation_count{ 0 };
+inline std::atomic<size_t> allocated_bytes{ 0 };
+inline std::atomic<size_t> live_bytes{ 0 };
+
+/// Order in which the keys are inserted and looked up.
+enum class distribution_t
+{
+	sequential,
+	random,
+	zipfian
+};
+
+inline const char* distribution_name(distribution_t distribution)
+{
+	switch (distribution)
+	{
+	case distribution_t::sequential:
+		return "sequential";
+	case distribution_t::random:
+		return "random";
+	default:
+		return "zipfian";
+	}
+}
+
+/** Generator of ranks in [0, n) following the Zipf distribution with exponent 'theta', after Gray et al., "Quickly generating billion-record synthetic databases".
+* Rank 0 is the most frequent one. The setup costs O(n) time and O(1) memory.
+*/
+class zipf_generator
+{
+	size_t n;
+	double theta, alpha, zeta_n, eta;
+	std::uniform_real_distribution<double> uniform;
+public:
+	zipf_generator(size_t _n, double _theta = 0.99) : n(_n), theta(_theta), uniform(0.0, 1.0)
+	{
+		zeta_n = 0.0;
+		for (size_t i = 1; i <= n; ++i)
+			zeta_n += 1.0 / std::pow(double(i), theta);
+		double zeta_2 = 1.0 + 1.0 / std::pow(2.0, theta);
+		alpha = 1.0 / (1.0 - theta);
+		eta = (1.0 - std::pow(2.0 / double(n), 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+	}
+	template <class generator_type>
+	size_t operator()(generator_type& generator)
+	{
+		double u = uniform(generator), uz = u * zeta_n;
+		if (uz < 1.0)
+			return 0;
+		if (uz < 1.0 + std::pow(0.5, theta))
+			return n > 1 ? 1 : 0;
+		return std::min(n - 1, size_t(double(n) * std::pow(eta * u - eta + 1.0, alpha)));
+	}
+};
+
+/// Turns the number 'number' into a key; the order of the numbers is preserved.
+template <class key_type>
+key_type make_key(size_t number);
+
+template <>
+inline int make_key<int>(size_t number)
+{
+	return int(number);
+}
+
+template <>
+inline std::string make_key<std::string>(size_t number)
+{
+	char buffer[24];
+	std::snprintf(buffer, sizeof(buffer), "key%012zu", number);
+	return buffer;
+}
+
+/// Adapters of the operations whose names or semantics differ between the measured containers. Returns how many of the extremes equal 'key'.
+template <class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t touch_extremes(my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& map, const key_type& key)
+{
+	return (map.min().first == key ? 1 : 0) + (map.max().first == key ? 1 : 0);
+}
+
+template <class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void serialize_map(my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& map, const std::string& name)
+{
+	map.serialize(name);
+}
+
+template <class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void deserialize_map(my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& map, const std::string& name)
+{
+	map.deserialize(name);
+}
+
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+size_t touch_extremes(my_btree<key_type, mapped_type, compare, node_bytes>& map, const key_type& key)
+{
+	return (map.min().first == key ? 1 : 0) + (map.max().first == key ? 1 : 0);
+}
+
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void serialize_map(my_btree<key_type, mapped_type, compare, node_bytes>& map, const std::string& name)
+{
+	map.serialize(name);
+}
+
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void deserialize_map(my_btree<key_type, mapped_type, compare, node_bytes>& map, const std::string& name)
+{
+	map.deserialize(name);
+}
+
+template <class key_type, class mapped_type>
+size_t touch_extremes(std::map<key_type, mapped_type>& map, const key_type& key)
+{
+	return (map.begin()->first == key ? 1 : 0) + (map.rbegin()->first == key ? 1 : 0);
+}
+
+/// Writes 'map' in the text format of my_map::serialize, so that both containers do the same work.
+template <class key_type, class mapped_type>
+void serialize_map(std::map<key_type, mapped_type>& map, const std::string& name)
+{
+	std::ofstream file(name, std::ios::out);
+	for (const auto& value : map)
+		file << value.first << ' ' << value.second << '\n';
+}
+
+template <class key_type, class mapped_type>
+void deserialize_map(std::map<key_type, mapped_type>& map, const std::string& name)
+{
+	std::ifstream file(name, std::ios::in);
+	std::pair<key_type, mapped_type> value;
+	while ((file >> value.first) and (file >> value.second))
+		map.insert(map.end(), value);
+}
+
+/// Nanoseconds per operation of every measured operation of one container, with the allocations made by the insertions.
+struct map_results
+{
+	static constexpr size_t number_of_operations = 9;
+	double nanoseconds[number_of_operations] = {};
+	double allocations_per_insert = 0.0;
+	double bytes_per_insert = 0.0;
+	/// The bytes held by the container of all the keys per key, averaged over the rounds.
+	double live_bytes_per_key = 0.0;
+};
+
+const char* const OPERATION_NAMES[map_results::number_of_operations] =
+{ "insert", "at hit", "find miss", "iterate", "min/max", "serialize", "deserialize", "erase", "destroy" };
+
+/// Keys and lookup sequences shared by all the containers measured in one case.
+template <class key_type>
+struct benchmark_case
+{
+	std::vector<key_type> inserted, hits, misses;
+};
+
+/** Prepares 'n' keys, which are the even numbers below 2n, inserted in the order given by 'distribution', and 'n' lookups of present keys
+* drawn from the same distribution and 'n' lookups of missing keys (the odd numbers).
+* @param size_t n - the number of keys
+* @param distribution_t distribution - the order of insertion and the distribution of lookups
+* @return the keys and the lookup sequences
+*/
+template <class key_type>
+benchmark_case<key_type> make_case(size_t n, distribution_t distribution)
+{
+	std::mt19937_64 generator(n);
+	std::vector<size_t> order(n);
+	for (size_t i = 0; i < n; ++i)
+		order[i] = i;
+	if (distribution != distribution_t::sequential)
+		std::shuffle(order.begin(), order.end(), generator);
+	benchmark_case<key_type> result;
+	result.inserted.reserve(n);
+	result.hits.reserve(n);
+	result.misses.reserve(n);
+	for (size_t i = 0; i < n; ++i)
+		result.inserted.push_back(make_key<key_type>(2 * order[i]));
+	if (distribution == distribution_t::zipfian)
+	{
+		zipf_generator zipf(n);
+		for (size_t i = 0; i < n; ++i)
+			result.hits.push_back(result.inserted[zipf(generator)]);
+	}
+	else if (distribution == distribution_t::random)
+	{
+		std::uniform_int_distribution<size_t> uniform(0, n - 1);
+		for (size_t i = 0; i < n; ++i)
+			result.hits.push_back(make_key<key_type>(2 * uniform(generator)));
+	}
+	else
+		result.hits = result.inserted;
+	for (size_t i = 0; i < n; ++i)
+		result.misses.push_back(make_key<key_type>(2 * order[i] + 1));
+	return result;
+}
+
+/** Measures every operation of 'map_type' on the keys of 'keys'. Maps of fewer than a million pairs are built 'rounds' times
+* and the times are averaged, so that small cases are measured over enough work.
+* @param const benchmark_case<key_type>& keys - the keys and the lookup sequences
+* @param size_t rounds - the number of repetitions
+* @param const std::string& file_name - the scratch file for serialization
+* @return the results
+*/
+template <class map_type, class key_type>
+map_results measure_map(const benchmark_case<key_type>& keys, size_t rounds, const std::string& file_name)
+{
+	using clock = std::chrono::steady_clock;
+	map_results results;
+	size_t n = keys.inserted.size(), sink = 0, allocations = 0, bytes = 0, live = 0;
+	double seconds[map_results::number_of_operations] = {};
+	auto elapsed = [](clock::time_point since) { return std::chrono::duration<double>(clock::now() - since).count(); };
+	for (size_t round = 0; round < rounds; ++round)
+	{
+		map_type* map = new map_type;
+		size_t allocations_before = allocation_count.load(), bytes_before = allocated_bytes.load(), live_before = live_bytes.load();
+		auto begin = clock::now();
+		for (const key_type& key : keys.inserted)
+			map->insert(std::make_pair(key, int(n)));
+		seconds[0] += elapsed(begin);
+		allocations += allocation_count.load() - allocations_before;
+		bytes += allocated_bytes.load() - bytes_before;
+		live += live_bytes.load() - live_before;
+
+		begin = clock::now();
+		for (const key_type& key : keys.hits)
+			sink += size_t(map->at(key));
+		seconds[1] += elapsed(begin);
+
+		begin = clock::now();
+		for (const key_type& key : keys.misses)
+			sink += map->find(key) == map->end() ? 1 : 0;
+		seconds[2] += elapsed(begin);
+
+		begin = clock::now();
+		for (const auto& value : *map)
+			sink += size_t(value.second);
+		seconds[3] += elapsed(begin);
+
+		begin = clock::now();
+		for (size_t i = 0; i < n; ++i)
+			sink += touch_extremes(*map, keys.inserted[0]);
+		seconds[4] += elapsed(begin);
+
+		begin = clock::now();
+		serialize_map(*map, file_name);
+		seconds[5] += elapsed(begin);
+
+		map_type* copy = new map_type;
+		begin = clock::now();
+		deserialize_map(*copy, file_name);
+		seconds[6] += elapsed(begin);
+		sink += copy->size();
+		delete copy;
+
+		begin = clock::now();
+		for (const key_type& key : keys.inserted)
+			map->erase(key);
+		seconds[7] += elapsed(begin);
+		sink += map->size();
+
+		for (const key_type& key : keys.inserted)
+			map->insert(std::make_pair(key, int(n)));
+		begin = clock::now();
+		delete map;
+		seconds[8] += elapsed(begin);
+	}
+	std::remove(file_name.c_str());
+	for (size_t i = 0; i < map_results::number_of_operations; ++i)
+		results.nanoseconds[i] = seconds[i] * 1e9 / double(n * rounds);
+	results.allocations_per_insert = double(allocations) / double(n * rounds);
+	results.bytes_per_insert = double(bytes) / double(n * rounds);
+	results.live_bytes_per_key = double(live) / double(n * rounds);
+	if (sink == size_t(-1))
+		std::cout << sink;
+	return results;
+}
+
+/** Prints the results of one case: ns/op and Mops/s of every operation for every container, relative to the first one, the baseline.
+* @param const std::string& title - the description of the case
+* @param const std::vector<std::string>& names - the names of the containers
+* @param const std::vector<map_results>& results - the results of the containers, in the same order
+* @return void
+*/
+inline void print_results(const std::string& title, const std::vector<std::string>& names, const std::vector<map_results>& results)
+{
+	std::cout << title << std::endl;
+	std::cout << std::setw(12) << "operation";
+	for (const std::string& name : names)
+		std::cout << std::setw(14) << (name + " ns") << std::setw(10) << "Mops/s";
+	for (size_t i = 1; i < names.size(); ++i)
+		std::cout << std::setw(18) << (names[i] + " speedup");
+	std::cout << std::endl << std::fixed;
+	for (size_t operation = 0; operation < map_results::number_of_operations; ++operation)
+	{
+		std::cout << std::setw(12) << OPERATION_NAMES[operation];
+		for (const map_results& result : results)
+			std::cout << std::setw(14) << std::setprecision(1) << result.nanoseconds[operation]
+			<< std::setw(10) << std::setprecision(2) << 1e3 / result.nanoseconds[operation];
+		for (size_t i = 1; i < results.size(); ++i)
+			std::cout << std::setw(17) << std::setprecision(2) << results[0].nanoseconds[operation] / results[i].nanoseconds[operation] << 'x';
+		std::cout << std::endl;
+	}
+	std::cout << std::setw(12) << "allocs/ins";
+	for (const map_results& result : results)
+		std::cout << std::setw(14) << std::setprecision(3) << result.allocations_per_insert << std::setw(10) << "";
+	std::cout << std::endl << std::setw(12) << "bytes/ins";
+	for (const map_results& result : results)
+		std::cout << std::setw(14) << std::setprecision(1) << result.bytes_per_insert << std::setw(10) << "";
+	std::cout << std::endl << std::setw(12) << "live B/key";
+	for (const map_results& result : results)
+		std::cout << std::setw(14) << std::setprecision(1) << result.live_bytes_per_key << std::setw(10) << "";
+	std::cout << std::endl << std::endl;
+}
+
+/// my_map of the balancing policy 'balance_policy', the other parameters being the defaults but for the statistics policy.
+template <class key_type, class balance_policy, class stats_policy = no_stats>
+using balanced_map = my_map<key_type, int, std::less<key_type>, pool_allocator<std::pair<key_type, int>>, stats_policy, no_augmentation, balance_policy>;
+
+/** Measures std::map, the baseline, my_map with each of its balancing policies and my_btree with keys of type 'key_type' in one case.
+* @param size_t n - the number of keys
+* @param distribution_t distribution - the order of insertion and the distribution of lookups
+* @param const char* key_name - the name of the key type to be printed
+* @return void
+*/
+template <class key_type>
+void benchmark_maps(size_t n, distribution_t distribution, const char* key_name)
+{
+	benchmark_case<key_type> keys = make_case<key_type>(n, distribution);
+	size_t rounds = std::max<size_t>(1, 1000000 / n);
+	std::vector<map_results> results;
+	results.push_back(measure_map<std::map<key_type, int>>(keys, rounds, "benchmark_map.txt"));
+	results.push_back(measure_map<my_map<key_type, int>>(keys, rounds, "benchmark_map.txt"));
+	results.push_back(measure_map<balanced_map<key_type, avl_balance>>(keys, rounds, "benchmark_map.txt"));
+	results.push_back(measure_map<balanced_map<key_type, treap_balance>>(keys, rounds, "benchmark_map.txt"));
+	results.push_back(measure_map<my_btree<key_type, int>>(keys, rounds, "benchmark_map.txt"));
+	std::string title = std::string(key_name) + " keys, " + distribution_name(distribution) + ", n = " + std::to_string(n);
+	print_results(title, { "std::map", "my_map", "AVL map", "treap map", "my_btree" }, results);
+}
+
+/** Measures the ingestion of 'n' increasing keys, as of timestamps or sequence numbers: plain insertion, which my_map appends at its rightmost node,
+* and insertion with 'end()' as the hint, against std::map. Every variant is repeated 'rounds' times and the times are averaged.
+* @param size_t n - the number of keys
+* @return void
+*/
+inline void benchmark_monotone_ingest(size_t n)
+{
+	using clock = std::chrono::steady_clock;
+	size_t rounds = std::max<size_t>(1, 1000000 / n), sink = 0;
+	auto measure = [&](auto make_map, auto insert)
+	{
+		double seconds = 0.0;
+		for (size_t round = 0; round < rounds; ++round)
+		{
+			auto* map = make_map();
+			auto begin = clock::now();
+			for (size_t i = 0; i < n; ++i)
+				insert(*map, std::make_pair(int(i), int(i)));
+			seconds += std::chrono::duration<double>(clock::now() - begin).count();
+			sink += map->size();
+			delete map;
+		}
+		return seconds * 1e9 / double(n * rounds);
+	};
+	double times[] =
+	{
+		measure([]() { return new std::map<int, int>; }, [](std::map<int, int>& map, const std::pair<int, int>& value) { map.insert(value); }),
+		measure([]() { return new std::map<int, int>; }, [](std::map<int, int>& map, const std::pair<int, int>& value) { map.insert(map.end(), value); }),
+		measure([]() { return new my_map<int, int>; }, [](my_map<int, int>& map, const std::pair<int, int>& value) { map.insert(value); }),
+		measure([]() { return new my_map<int, int>; }, [](my_map<int, int>& map, const std::pair<int, int>& value) { map.insert(map.end(), value); })
+	};
+	const char* names[] = { "std::map insert", "std::map hint", "my_map insert", "my_map hint" };
+	std::cout << "monotone ingest, int keys, n = " << n << std::endl << std::fixed;
+	for (size_t i = 0; i < 4; ++i)
+		std::cout << std::setw(18) << names[i] << std::setw(10) << std::setprecision(1) << times[i] << " ns" << std::setw(10)
+		<< std::setprecision(2) << times[0] / times[i] << 'x' << std::endl;
+	std::cout << std::endl;
+	if (sink == size_t(-1))
+		std::cout << sink;
+}
+
+/** Measures batched lookups of random keys, half of them present, in batches of 'batch' keys: 'find' in a loop against 'find_many'
+* of my_map, with std::map for reference. The interleaving pays off once the tree outgrows the last-level cache.
+* @param size_t n - the number of pairs in the maps
+* @param size_t batch - the number of keys looked up at once
+* @return void
+*/
+inline void benchmark_find_many(size_t n, size_t batch)
+{
+	using clock = std::chrono::steady_clock;
+	std::mt19937 generator(1);
+	std::vector<int> present(n);
+	for (int& key : present)
+		key = int(generator() >> 1);
+	std::map<int, int> reference;
+	my_map<int, int> map;
+	for (int key : present)
+	{
+		reference.insert(std::make_pair(key, key));
+		map.insert(std::make_pair(key, key));
+	}
+	std::vector<int> keys(std::max<size_t>(batch, 4000000 / batch * batch));
+	for (size_t i = 0; i < keys.size(); ++i)
+		keys[i] = (i % 2 == 0 ? present[generator() % n] : int(generator() >> 1));
+	size_t sink = 0;
+	auto measure = [&](auto lookup)
+	{
+		auto begin = clock::now();
+		for (size_t i = 0; i < keys.size(); i += batch)
+			sink += lookup(keys.data() + i, keys.data() + i + batch);
+		return std::chrono::duration<double>(clock::now() - begin).count() * 1e9 / double(keys.size());
+	};
+	std::vector<my_map<int, int>::const_iterator> found(batch);
+	const my_map<int, int>& constant = map;
+	double times[] =
+	{
+		measure([&](const int* first, const int* last)
+			{
+				size_t count = 0;
+				for (; first != last; ++first)
+					count += (reference.find(*first) != reference.end() ? 1 : 0);
+				return count;
+			}),
+		measure([&](const int* first, const int* last)
+			{
+				size_t count = 0;
+				for (; first != last; ++first)
+					count += (constant.find(*first) != constant.end() ? 1 : 0);
+				return count;
+			}),
+		measure([&](const int* first, const int* last) { return constant.find_many(first, last, found.begin()); })
+	};
+	const char* names[] = { "std::map find", "my_map find", "my_map find_many" };
+	std::cout << "batched lookups, int keys, n = " << n << ", batch = " << batch << std::endl << std::fixed;
+	for (size_t i = 0; i < 3; ++i)
+		std::cout << std::setw(18) << names[i] << std::setw(10) << std::setprecision(1) << times[i] << " ns" << std::setw(10)
+		<< std::setprecision(2) << times[0] / times[i] << 'x' << std::endl;
+	std::cout << std::endl;
+	if (sink == size_t(-1))
+		std::cout << sink;
+}
+
+/** Counts the rebalancing work of one balancing policy of my_map on 'keys': all of them are inserted, looked up and then the first half erased.
+* Prints the rotations and the updated balances per insertion and per erasure, the average descent of the lookups and the shape of the tree.
+* @param const std::vector<int>& keys - the keys, in the order of insertion
+* @param const char* name - the name of the policy to be printed
+* @return void
+*/
+template <class balance_policy>
+void measure_balancing(const std::vector<int>& keys, const char* name)
+{
+	balanced_map<int, balance_policy, counting_stats> map;
+	for (int key : keys)
+		map.insert(std::make_pair(key, key));
+	counting_stats inserted = map.stats();
+	map.stats().reset();
+	size_t sink = 0;
+	for (int key : keys)
+		sink += (map.contains(key) ? 1 : 0);
+	double descent = map.stats().average_descent_length();
+	inspection_report report = map.inspect();
+	map.stats().reset();
+	for (size_t i = 0; i < keys.size() / 2; ++i)
+		map.erase(keys[i]);
+	const counting_stats& erased = map.stats();
+	double inserts = double(keys.size()), erases = double(keys.size() / 2);
+	std::cout << std::setw(12) << name << std::setw(14) << std::setprecision(3) << double(inserted.rotations) / inserts
+		<< std::setw(14) << double(inserted.recolourings) / inserts << std::setw(14) << double(erased.rotations) / erases
+		<< std::setw(14) << double(erased.recolourings) / erases << std::setw(14) << std::setprecision(2) << descent
+		<< std::setw(10) << report.height << std::endl;
+	if (sink == size_t(-1))
+		std::cout << sink;
+}
+
+/** Compares the rebalancing work of the balancing policies of my_map, red-black, AVL and treap, on 'n' random and 'n' increasing keys.
+* @param size_t n - the number of keys
+* @return void
+*/
+inline void benchmark_balancing(size_t n)
+{
+	std::mt19937 generator(1);
+	std::vector<int> keys(n);
+	for (size_t i = 0; i < n; ++i)
+		keys[i] = int(i);
+	for (bool random : { false, true })
+	{
+		if (random)
+			std::shuffle(keys.begin(), keys.end(), generator);
+		std::cout << "balancing policies, " << (random ? "random" : "increasing") << " int keys, n = " << n << std::endl << std::fixed;
+		std::cout << std::setw(12) << "policy" << std::setw(14) << "rot/ins" << std::setw(14) << "balance/ins" << std::setw(14) << "rot/erase"
+			<< std::setw(14) << "balance/erase" << std::setw(14) << "avg descent" << std::setw(10) << "height" << std::endl;
+		measure_balancing<red_black_balance>(keys, "red-black");
+		measure_balancing<avl_balance>(keys, "AVL");
+		measure_balancing<treap_balance>(keys, "treap");
+		std::cout << std::endl;
+	}
+}
+
+/** Measures the throughput of durable insertions into my_durable_map with fsync after every group of 1, 64 and 1024 records.
+* A single record per group is measured on fewer insertions, since every one of them waits for the disk.
+* @param size_t n - the number of insertions for the larger groups
+* @return void
+*/
+inline void benchmark_durable_writes(size_t n)
+{
+	const size_t group_sizes[] = { 1, 64, 1024 };
+	std::cout << "durable inserts, int keys" << std::endl << std::fixed;
+	for (size_t group_size : group_sizes)
+	{
+		std::remove("benchmark_durable.snapshot");
+		std::remove("benchmark_durable.log");
+		durability_options options;
+		options.group_size = group_size;
+		options.checkpoint_bytes = 0;
+		size_t count = (group_size == 1 ? std::min<size_t>(n, 2000) : n);
+		auto begin = std::chrono::steady_clock::now();
+		{
+			my_durable_map<int, int> map("benchmark_durable", options);
+			for (size_t i = 0; i < count; ++i)
+				map.insert(std::make_pair(int(i), int(i)));
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		std::cout << std::setw(12) << "group " << std::setw(6) << group_size << std::setw(14) << std::setprecision(0) << double(count) / seconds << " ops/s" << std::endl;
+	}
+	std::remove("benchmark_durable.snapshot");
+	std::remove("benchmark_durable.log");
+	std::cout << std::endl;
+}
+
+/** Runs the whole single-threaded suite: sequential, random and Zipfian keys, int and std::string keys, and the monotone ingestion, for 1e3, 1e4, ... up to 'max_elements' pairs,
+* then the batched lookups of 'max_elements' pairs, the rebalancing work of the balancing policies and the durable insertions.
+* The allocations and the live bytes are counted for the measured insertions only; the live bytes are what the full container holds.
+* @param size_t max_elements - the greatest number of pairs
+* @return void
+*/
+inline void map_benchmark(size_t max_elements)
+{
+	const distribution_t distributions[] = { distribution_t::sequential, distribution_t::random, distribution_t::zipfian };
+	for (size_t n = 1000; n <= max_elements; n *= 10)
+	{
+		for (distribution_t distribution : distributions)
+		{
+			benchmark_maps<int>(n, distribution, "int");
+			benchmark_maps<std::string>(n, distribution, "string");
+		}
+		benchmark_monotone_ingest(n);
+	}
+	benchmark_find_many(max_elements, 256);
+	benchmark_balancing(max_elements);
+	benchmark_durable_writes(std::min<size_t>(max_elements, 1000000));
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Read-only memory mapping of a whole file. The mapping is released when the object is destroyed.
+class mapped_file
+{
+	const char* my_data = nullptr;
+	size_t my_size = 0;
+	bool opened = false;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+public:
+	mapped_file() = default;
+	explicit mapped_file(const std::string& name) { open(name); }
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file(mapped_file&& other) noexcept;
+	mapped_file& operator=(mapped_file&& other) noexcept;
+	~mapped_file() { close(); }
+
+	bool open(const std::string& name);
+	void close();
+	bool is_open() const { return opened; }
+	const char* data() const { return my_data; }
+	size_t size() const { return my_size; }
+};
+
+/** Move constructor of class mapped_file. Takes over the mapping of 'other'.
+* @param mapped_file&& other - an rvalue mapping to be taken
+*/
+inline mapped_file::mapped_file(mapped_file&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+/** Move assignment of class mapped_file. Releases the present mapping and takes over the mapping of 'other'.
+* @param mapped_file&& other - an rvalue mapping to be taken
+* @return reference to this object
+*/
+inline mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		my_data = other.my_data;
+		my_size = other.my_size;
+		opened = other.opened;
+#ifdef _WIN32
+		file = other.file;
+		mapping = other.mapping;
+		other.file = INVALID_HANDLE_VALUE;
+		other.mapping = nullptr;
+#endif
+		other.my_data = nullptr;
+		other.my_size = 0;
+		other.opened = false;
+	}
+	return *this;
+}
+
+/** Maps the file 'name' into memory for reading. An empty file is opened with no data.
+* @param const std::string& name - the name of the file
+* @return true if the file has been mapped, false otherwise
+*/
+inline bool mapped_file::open(const std::string& name)
+{
+	close();
+#ifdef _WIN32
+	file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER length;
+	if (not GetFileSizeEx(file, &length))
+	{
+		close();
+		return false;
+	}
+	my_size = static_cast<size_t>(length.QuadPart);
+	if (my_size > 0)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			close();
+			return false;
+		}
+		my_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (my_data == nullptr)
+		{
+			close();
+			return false;
+		}
+	}
+#else
+	int descriptor = ::open(name.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+	struct stat status;
+	if (fstat(descriptor, &status) != 0)
+	{
+		::close(descriptor);
+		return false;
+	}
+	my_size = static_cast<size_t>(status.st_size);
+	if (my_size > 0)
+	{
+		void* address = mmap(nullptr, my_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (address == MAP_FAILED)
+		{
+			::close(descriptor);
+			my_size = 0;
+			return false;
+		}
+		my_data = static_cast<const char*>(address);
+	}
+	::close(descriptor);
+#endif
+	opened = true;
+	return true;
+}
+
+/** Releases the mapping, if any.
+* @return void
+*/
+inline void mapped_file::close()
+{
+#ifdef _WIN32
+	if (my_data != nullptr)
+		UnmapViewOfFile(my_data);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (my_data != nullptr)
+		munmap(const_cast<char*>(my_data), my_size);
+#endif
+	my_data = nullptr;
+	my_size = 0;
+	opened = false;
+}
@@ -0,0 +1,952 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MY_BTREE_AVX2
+#endif
+#if defined(__SSE4_2__) || defined(__AVX2__)
+#include <nmmintrin.h>
+#define MY_BTREE_SSE42
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MY_BTREE_SSE2
+#endif
+
+#include "my_map.cpp"
+
+/** Search inside a node of my_btree: the number of keys less than a key ('lower') and not greater than it ('upper').
+* The keys of the node are sorted, so both are the lengths of a prefix. The general version performs a binary search with the comparator.
+* @param key_type - the type of the keys
+* @param compare - the ordering of the keys
+*/
+template <class key_type, class compare, class = void>
+struct node_search
+{
+	static size_t lower(const key_type* keys, size_t count, const key_type& key, const compare& less)
+	{
+		return std::lower_bound(keys, keys + count, key, less) - keys;
+	}
+	static size_t upper(const key_type* keys, size_t count, const key_type& key, const compare& less)
+	{
+		return std::upper_bound(keys, keys + count, key, less) - keys;
+	}
+};
+
+/// Returns the number of the lowest set bits of 'mask' that are all set.
+inline size_t trailing_ones(unsigned mask)
+{
+	size_t count = 0;
+	for (; mask & 1; mask >>= 1)
+		++count;
+	return count;
+}
+
+/** Vector comparisons of 'width' keys of type 'key_type' at once. 'less' and 'greater' return a mask with bit i set if the i-th key
+* is less, respectively greater, than 'key'. Not specialised for the types or instruction sets with no suitable comparison.
+*/
+template <class key_type>
+struct simd_lanes
+{
+	static constexpr size_t width = 0;
+};
+
+#if defined(MY_BTREE_AVX2)
+template <>
+struct simd_lanes<int32_t>
+{
+	static constexpr size_t width = 8;
+	static unsigned less(const int32_t* keys, int32_t key)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+		return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(key), block))));
+	}
+	static unsigned greater(const int32_t* keys, int32_t key)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+		return unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(block, _mm256_set1_epi32(key)))));
+	}
+};
+
+template <>
+struct simd_lanes<int64_t>
+{
+	static constexpr size_t width = 4;
+	static unsigned less(const int64_t* keys, int64_t key)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+		return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_set1_epi64x(key), block))));
+	}
+	static unsigned greater(const int64_t* keys, int64_t key)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+		return unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(block, _mm256_set1_epi64x(key)))));
+	}
+};
+#elif defined(MY_BTREE_SSE2)
+template <>
+struct simd_lanes<int32_t>
+{
+	static constexpr size_t width = 4;
+	static unsigned less(const int32_t* keys, int32_t key)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+		return unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(block, _mm_set1_epi32(key)))));
+	}
+	static unsigned greater(const int32_t* keys, int32_t key)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+		return unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, _mm_set1_epi32(key)))));
+	}
+};
+
+#if defined(MY_BTREE_SSE42)
+template <>
+struct simd_lanes<int64_t>
+{
+	static constexpr size_t width = 2;
+	static unsigned less(const int64_t* keys, int64_t key)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+		return unsigned(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(_mm_set1_epi64x(key), block))));
+	}
+	static unsigned greater(const int64_t* keys, int64_t key)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+		return unsigned(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(block, _mm_set1_epi64x(key)))));
+	}
+};
+#endif
+#endif
+
+#if defined(MY_BTREE_SSE2)
+template <>
+struct simd_lanes<float>
+{
+	static constexpr size_t width = 4;
+	static unsigned less(const float* keys, float key)
+	{
+		return unsigned(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys), _mm_set1_ps(key))));
+	}
+	static unsigned greater(const float* keys, float key)
+	{
+		return unsigned(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(keys), _mm_set1_ps(key))));
+	}
+};
+
+template <>
+struct simd_lanes<double>
+{
+	static constexpr size_t width = 2;
+	static unsigned less(const double* keys, double key)
+	{
+		return unsigned(_mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(keys), _mm_set1_pd(key))));
+	}
+	static unsigned greater(const double* keys, double key)
+	{
+		return unsigned(_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(keys), _mm_set1_pd(key))));
+	}
+};
+#endif
+
+/// Tells whether the keys of type 'key_type' ordered by 'compare' can be searched with simd_lanes: the natural order of a type with vector comparisons.
+template <class key_type, class compare>
+struct simd_searchable : std::integral_constant<bool, (simd_lanes<key_type>::width > 0)
+	and (std::is_same<compare, std::less<key_type>>::value or std::is_same<compare, std::less<>>::value)> {};
+
+/** Search inside a node of my_btree with vector comparisons. The keys are compared 'width' at a time, from the front,
+* until a block is found that is not entirely less (not greater); the rest is scanned one by one.
+*/
+template <class key_type, class compare>
+struct node_search<key_type, compare, typename std::enable_if<simd_searchable<key_type, compare>::value>::type>
+{
+	using lanes = simd_lanes<key_type>;
+	static constexpr unsigned all = (1u << lanes::width) - 1;
+	static size_t lower(const key_type* keys, size_t count, const key_type& key, const compare&)
+	{
+		size_t i = 0;
+		for (; i + lanes::width <= count; i += lanes::width)
+		{
+			unsigned mask = lanes::less(keys + i, key);
+			if (mask != all)
+				return i + trailing_ones(mask);
+		}
+		while (i < count and keys[i] < key)
+			++i;
+		return i;
+	}
+	static size_t upper(const key_type* keys, size_t count, const key_type& key, const compare&)
+	{
+		size_t i = 0;
+		for (; i + lanes::width <= count; i += lanes::width)
+		{
+			unsigned mask = lanes::greater(keys + i, key);
+			if (mask != 0)
+				return i + trailing_ones(~mask & all);
+		}
+		while (i < count and not (key < keys[i]))
+			++i;
+		return i;
+	}
+};
+
+/** Implementation of a map as a B+ tree. The nodes hold many keys each, about 'node_bytes' bytes of them, so a lookup
+* costs one cache miss per level of a much lower tree than a red-black one. The pairs are kept in the leaves, which are linked
+* for iteration; the keys of a node are stored contiguously, apart from the mapped values, and for arithmetic keys in their natural order
+* they are searched with vector comparisons (SSE2, SSE4.2 or AVX2, whichever the compiler targets).
+* The interface follows my_map; unlike there, the iterators yield proxy pairs of references, as the keys and values are stored apart,
+* and for the same reason 'min' and 'max' return copies of the pairs rather than references.
+* Both 'key_type' and 'mapped_type' have to be default constructible.
+* @param key_type - the type used as the key
+* @param mapped_type - the type of data assigned to the keys
+* @param compare - the strict weak ordering of the keys, std::less<key_type> by default
+* @param node_bytes - the approximate size of the keys and values of a single node, 256 by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>, size_t node_bytes = 256>
+class my_btree
+{
+public:
+	using value_type = std::pair<key_type, mapped_type>;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+private:
+	static constexpr size_t leaf_capacity = std::max<size_t>(4, node_bytes / (sizeof(key_type) + sizeof(mapped_type)));
+	static constexpr size_t inner_capacity = std::max<size_t>(4, node_bytes / (sizeof(key_type) + sizeof(void*)));
+	using search = node_search<key_type, compare>;
+	struct node
+	{
+		size_t count;
+		bool leaf;
+		explicit node(bool _leaf) : count(0), leaf(_leaf) {}
+	};
+	struct leaf_node : node
+	{
+		key_type keys[leaf_capacity];
+		mapped_type values[leaf_capacity];
+		leaf_node* previous, * next;
+		leaf_node() : node(true), previous(nullptr), next(nullptr) {}
+	};
+	/// Inner node: all the keys of children[i] are less than keys[i], all the keys of children[i + 1] are not.
+	struct inner_node : node
+	{
+		key_type keys[inner_capacity];
+		node* children[inner_capacity + 1];
+		inner_node() : node(false) {}
+	};
+	node* root;
+	leaf_node* first_leaf, * last_leaf;
+	size_t number_of_pairs;
+	compare key_compare;
+	void destroy(node* point);
+	leaf_node* find_leaf(const key_type& key) const;
+	node* insert(node* point, const value_type& value, key_type& separator, leaf_node*& where, size_t& position, bool& inserted);
+	bool erase(node* point, const key_type& key);
+	void fix_child(inner_node* parent, size_t index);
+	void link_after(leaf_node* point, leaf_node* fresh);
+	void unlink(leaf_node* point);
+public:
+	my_btree();
+	my_btree(my_btree&& other);
+	my_btree(const my_btree&) = delete;
+	my_btree& operator=(const my_btree&) = delete;
+	~my_btree();
+
+	template <bool constant>
+	class basic_iterator;
+	using iterator = basic_iterator<false>;
+	using const_iterator = basic_iterator<true>;
+
+	std::pair<iterator, bool> insert(const value_type& value);
+	void erase(const key_type& key);
+	value_type min() const;
+	value_type max() const;
+	iterator begin() { return iterator(first_leaf, 0, this); }
+	const_iterator begin() const { return const_iterator(first_leaf, 0, this); }
+	const_iterator cbegin() const { return begin(); }
+	iterator end() { return iterator(nullptr, 0, this); }
+	const_iterator end() const { return const_iterator(nullptr, 0, this); }
+	const_iterator cend() const { return end(); }
+	iterator find(const key_type& key);
+	const_iterator find(const key_type& key) const;
+	iterator lower_bound(const key_type& key);
+	const_iterator lower_bound(const key_type& key) const;
+	bool contains(const key_type& key) const;
+	size_t count(const key_type& key) const;
+	mapped_type& at(const key_type& key);
+	const mapped_type& at(const key_type& key) const;
+	template <class function_type>
+	void for_each_in_range(const key_type& low, const key_type& high, function_type function) const;
+	template <class iterator_type>
+	void build(iterator_type first, iterator_type last);
+	void serialize(const std::string& name) const;
+	void deserialize(const std::string& name);
+	bool empty() const { return root == nullptr; }
+	size_t size() const { return number_of_pairs; }
+
+	/** Bidirectional iterator over the pairs in the ascending order of keys, walking the linked leaves. Dereferencing gives a pair
+	* of references to the key and to the mapped value, so 'it->first' and 'it->second' work as for my_map, but the pair itself is a temporary.
+	* @param constant - true for const_iterator, false for iterator
+	*/
+	template <bool constant>
+	class basic_iterator
+	{
+		friend class my_btree;
+		template <bool> friend class basic_iterator;
+		using tree_pointer = const my_btree*;
+		leaf_node* leaf;
+		size_t index;
+		tree_pointer owner;
+		basic_iterator(leaf_node* _leaf, size_t _index, tree_pointer _owner) : leaf(_leaf), index(_index), owner(_owner) {}
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = typename my_btree::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = std::pair<const key_type&, typename std::conditional<constant, const mapped_type&, mapped_type&>::type>;
+		/// Holds the temporary pair, so that 'operator->' can return its address.
+		struct pointer
+		{
+			reference pair;
+			const reference* operator->() const { return &pair; }
+		};
+
+		basic_iterator() : leaf(nullptr), index(0), owner(nullptr) {}
+		/// Converts an iterator to a const_iterator.
+		template <bool other, class = typename std::enable_if<constant and not other>::type>
+		basic_iterator(const basic_iterator<other>& it) : leaf(it.leaf), index(it.index), owner(it.owner) {}
+		reference operator*() const { return reference(leaf->keys[index], leaf->values[index]); }
+		pointer operator->() const { return pointer{ **this }; }
+		basic_iterator& operator++()
+		{
+			if (++index == leaf->count)
+			{
+				leaf = leaf->next;
+				index = 0;
+			}
+			return *this;
+		}
+		basic_iterator operator++(int)
+		{
+			basic_iterator previous = *this;
+			++*this;
+			return previous;
+		}
+		basic_iterator& operator--()
+		{
+			if (leaf == nullptr)
+			{
+				leaf = owner->last_leaf;
+				index = leaf->count - 1;
+			}
+			else if (index == 0)
+			{
+				leaf = leaf->previous;
+				index = leaf->count - 1;
+			}
+			else
+				--index;
+			return *this;
+		}
+		basic_iterator operator--(int)
+		{
+			basic_iterator previous = *this;
+			--*this;
+			return previous;
+		}
+		template <bool other>
+		bool operator==(const basic_iterator<other>& it) const { return leaf == it.leaf and index == it.index; }
+		template <bool other>
+		bool operator!=(const basic_iterator<other>& it) const { return not (*this == it); }
+	};
+};
+
+/// Constructor of class my_btree<key_type, mapped_type, compare, node_bytes>. The tree is empty.
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+my_btree<key_type, mapped_type, compare, node_bytes>::my_btree()
+	: root(nullptr), first_leaf(nullptr), last_leaf(nullptr), number_of_pairs(0)
+{
+}
+
+/** Move constructor of class my_btree<key_type, mapped_type, compare, node_bytes>. Takes over the contents of 'other'.
+* @param my_btree<key_type, mapped_type, compare, node_bytes>&& other - an rvalue tree whose contents should be taken
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+my_btree<key_type, mapped_type, compare, node_bytes>::my_btree(my_btree&& other)
+	: root(other.root), first_leaf(other.first_leaf), last_leaf(other.last_leaf), number_of_pairs(other.number_of_pairs)
+{
+	other.root = nullptr;
+	other.first_leaf = other.last_leaf = nullptr;
+	other.number_of_pairs = 0;
+}
+
+/// Destructor of class my_btree<key_type, mapped_type, compare, node_bytes>. Destroys all the nodes.
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+my_btree<key_type, mapped_type, compare, node_bytes>::~my_btree()
+{
+	destroy(root);
+}
+
+/** Destroys the whole subtree rooted in the node indicated by 'point'.
+* @param node* point - the pointer to the root of the subtree or nullptr
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::destroy(node* point)
+{
+	if (point == nullptr)
+		return;
+	if (point->leaf)
+	{
+		delete static_cast<leaf_node*>(point);
+		return;
+	}
+	inner_node* inner = static_cast<inner_node*>(point);
+	for (size_t i = 0; i <= inner->count; ++i)
+		destroy(inner->children[i]);
+	delete inner;
+}
+
+/** Descends to the leaf where the key 'key' is or would be.
+* @param const key_type& key - the key
+* @return pointer to the leaf, nullptr if the tree is empty
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::leaf_node* my_btree<key_type, mapped_type, compare, node_bytes>::find_leaf(const key_type& key) const
+{
+	node* point = root;
+	while (point != nullptr and not point->leaf)
+	{
+		inner_node* inner = static_cast<inner_node*>(point);
+		point = inner->children[search::upper(inner->keys, inner->count, key, key_compare)];
+	}
+	return static_cast<leaf_node*>(point);
+}
+
+/** Puts the leaf 'fresh' after the leaf 'point' in the list of leaves.
+* @param leaf_node* point - the leaf already in the list
+* @param leaf_node* fresh - the new leaf
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::link_after(leaf_node* point, leaf_node* fresh)
+{
+	fresh->previous = point;
+	fresh->next = point->next;
+	if (point->next != nullptr)
+		point->next->previous = fresh;
+	else
+		last_leaf = fresh;
+	point->next = fresh;
+}
+
+/** Removes the leaf 'point' from the list of leaves.
+* @param leaf_node* point - the leaf to be removed
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::unlink(leaf_node* point)
+{
+	if (point->previous != nullptr)
+		point->previous->next = point->next;
+	else
+		first_leaf = point->next;
+	if (point->next != nullptr)
+		point->next->previous = point->previous;
+	else
+		last_leaf = point->previous;
+}
+
+/** Inserts 'value' into the subtree 'point'. If the root of the subtree overflows, it is split in two halves.
+* @param node* point - the root of the subtree
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @param key_type& separator - receives the least key of the new right half after a split
+* @param leaf_node*& where - receives the leaf holding the key
+* @param size_t& position - receives the index of the key in that leaf
+* @param bool& inserted - set to false if the key is already present
+* @return the new right half, nullptr if no split has occurred
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::node* my_btree<key_type, mapped_type, compare, node_bytes>::insert(node* point, const value_type& value, key_type& separator, leaf_node*& where, size_t& position, bool& inserted)
+{
+	if (point->leaf)
+	{
+		leaf_node* leaf = static_cast<leaf_node*>(point);
+		size_t index = search::lower(leaf->keys, leaf->count, value.first, key_compare);
+		if (index < leaf->count and not key_compare(value.first, leaf->keys[index]))
+		{
+			where = leaf;
+			position = index;
+			inserted = false;
+			return nullptr;
+		}
+		leaf_node* right = nullptr;
+		if (leaf->count == leaf_capacity)
+		{
+			right = new leaf_node;
+			size_t middle = leaf_capacity / 2;
+			std::move(leaf->keys + middle, leaf->keys + leaf_capacity, right->keys);
+			std::move(leaf->values + middle, leaf->values + leaf_capacity, right->values);
+			right->count = leaf_capacity - middle;
+			leaf->count = middle;
+			link_after(leaf, right);
+			if (index > middle)
+			{
+				leaf = right;
+				index -= middle;
+			}
+		}
+		std::move_backward(leaf->keys + index, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+		std::move_backward(leaf->values + index, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+		leaf->keys[index] = value.first;
+		leaf->values[index] = value.second;
+		++leaf->count;
+		where = leaf;
+		position = index;
+		if (right != nullptr)
+			separator = right->keys[0];
+		return right;
+	}
+	inner_node* inner = static_cast<inner_node*>(point);
+	size_t index = search::upper(inner->keys, inner->count, value.first, key_compare);
+	key_type child_separator;
+	node* child_right = insert(inner->children[index], value, child_separator, where, position, inserted);
+	if (child_right == nullptr)
+		return nullptr;
+	if (inner->count < inner_capacity)
+	{
+		std::move_backward(inner->keys + index, inner->keys + inner->count, inner->keys + inner->count + 1);
+		std::move_backward(inner->children + index + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+		inner->keys[index] = std::move(child_separator);
+		inner->children[index + 1] = child_right;
+		++inner->count;
+		return nullptr;
+	}
+	key_type keys[inner_capacity + 1];
+	node* children[inner_capacity + 2];
+	std::move(inner->keys, inner->keys + index, keys);
+	keys[index] = std::move(child_separator);
+	std::move(inner->keys + index, inner->keys + inner_capacity, keys + index + 1);
+	std::copy(inner->children, inner->children + index + 1, children);
+	children[index + 1] = child_right;
+	std::copy(inner->children + index + 1, inner->children + inner_capacity + 1, children + index + 2);
+	size_t middle = (inner_capacity + 1) / 2;
+	inner_node* right = new inner_node;
+	std::move(keys, keys + middle, inner->keys);
+	std::copy(children, children + middle + 1, inner->children);
+	inner->count = middle;
+	separator = std::move(keys[middle]);
+	std::move(keys + middle + 1, keys + inner_capacity + 1, right->keys);
+	std::copy(children + middle + 1, children + inner_capacity + 2, right->children);
+	right->count = inner_capacity - middle;
+	return right;
+}
+
+/** Performs insertion into the map. A present key keeps its value.
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return the iterator to the pair of the key and whether it has been inserted, as for my_map
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+std::pair<typename my_btree<key_type, mapped_type, compare, node_bytes>::iterator, bool> my_btree<key_type, mapped_type, compare, node_bytes>::insert(const value_type& value)
+{
+	if (root == nullptr)
+	{
+		leaf_node* leaf = new leaf_node;
+		leaf->keys[0] = value.first;
+		leaf->values[0] = value.second;
+		leaf->count = 1;
+		root = first_leaf = last_leaf = leaf;
+		number_of_pairs = 1;
+		return { iterator(leaf, 0, this), true };
+	}
+	key_type separator;
+	leaf_node* where = nullptr;
+	size_t position = 0;
+	bool inserted = true;
+	node* right = insert(root, value, separator, where, position, inserted);
+	if (right != nullptr)
+	{
+		inner_node* fresh = new inner_node;
+		fresh->keys[0] = std::move(separator);
+		fresh->children[0] = root;
+		fresh->children[1] = right;
+		fresh->count = 1;
+		root = fresh;
+	}
+	if (inserted)
+		++number_of_pairs;
+	return { iterator(where, position, this), inserted };
+}
+
+/** Restores the minimal occupancy of the child 'index' of 'parent' by moving a key from a sibling or merging it with a sibling.
+* A node is deficient if it is less than half full.
+* @param inner_node* parent - the parent of the child
+* @param size_t index - the position of the child
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::fix_child(inner_node* parent, size_t index)
+{
+	node* child = parent->children[index];
+	if (child->count >= (child->leaf ? leaf_capacity : inner_capacity) / 2)
+		return;
+	size_t left_index = index > 0 ? index - 1 : 0;
+	node* left = parent->children[left_index], * right = parent->children[left_index + 1];
+	bool merge;
+	if (child->leaf)
+	{
+		leaf_node* left_leaf = static_cast<leaf_node*>(left), * right_leaf = static_cast<leaf_node*>(right);
+		merge = left->count + right->count <= leaf_capacity;
+		if (merge)
+		{
+			std::move(right_leaf->keys, right_leaf->keys + right->count, left_leaf->keys + left->count);
+			std::move(right_leaf->values, right_leaf->values + right->count, left_leaf->values + left->count);
+			left->count += right->count;
+			unlink(right_leaf);
+			delete right_leaf;
+		}
+		else if (left->count < right->count)
+		{
+			left_leaf->keys[left->count] = std::move(right_leaf->keys[0]);
+			left_leaf->values[left->count] = std::move(right_leaf->values[0]);
+			++left->count;
+			std::move(right_leaf->keys + 1, right_leaf->keys + right->count, right_leaf->keys);
+			std::move(right_leaf->values + 1, right_leaf->values + right->count, right_leaf->values);
+			--right->count;
+			parent->keys[left_index] = right_leaf->keys[0];
+		}
+		else
+		{
+			std::move_backward(right_leaf->keys, right_leaf->keys + right->count, right_leaf->keys + right->count + 1);
+			std::move_backward(right_leaf->values, right_leaf->values + right->count, right_leaf->values + right->count + 1);
+			++right->count;
+			--left->count;
+			right_leaf->keys[0] = std::move(left_leaf->keys[left->count]);
+			right_leaf->values[0] = std::move(left_leaf->values[left->count]);
+			parent->keys[left_index] = right_leaf->keys[0];
+		}
+	}
+	else
+	{
+		inner_node* left_inner = static_cast<inner_node*>(left), * right_inner = static_cast<inner_node*>(right);
+		merge = left->count + 1 + right->count <= inner_capacity;
+		if (merge)
+		{
+			left_inner->keys[left->count] = std::move(parent->keys[left_index]);
+			std::move(right_inner->keys, right_inner->keys + right->count, left_inner->keys + left->count + 1);
+			std::copy(right_inner->children, right_inner->children + right->count + 1, left_inner->children + left->count + 1);
+			left->count += right->count + 1;
+			delete right_inner;
+		}
+		else if (left->count < right->count)
+		{
+			left_inner->keys[left->count] = std::move(parent->keys[left_index]);
+			left_inner->children[left->count + 1] = right_inner->children[0];
+			++left->count;
+			parent->keys[left_index] = std::move(right_inner->keys[0]);
+			std::move(right_inner->keys + 1, right_inner->keys + right->count, right_inner->keys);
+			std::copy(right_inner->children + 1, right_inner->children + right->count + 1, right_inner->children);
+			--right->count;
+		}
+		else
+		{
+			std::move_backward(right_inner->keys, right_inner->keys + right->count, right_inner->keys + right->count + 1);
+			std::copy_backward(right_inner->children, right_inner->children + right->count + 1, right_inner->children + right->count + 2);
+			++right->count;
+			right_inner->keys[0] = std::move(parent->keys[left_index]);
+			right_inner->children[0] = left_inner->children[left->count];
+			parent->keys[left_index] = std::move(left_inner->keys[left->count - 1]);
+			--left->count;
+		}
+	}
+	if (merge)
+	{
+		std::move(parent->keys + left_index + 1, parent->keys + parent->count, parent->keys + left_index);
+		std::copy(parent->children + left_index + 2, parent->children + parent->count + 1, parent->children + left_index + 1);
+		--parent->count;
+	}
+}
+
+/** Erases the key 'key' from the subtree 'point', which may be left deficient; its parent restores it.
+* @param node* point - the root of the subtree
+* @param const key_type& key - the key to be erased
+* @return true if the key has been found, false otherwise
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+bool my_btree<key_type, mapped_type, compare, node_bytes>::erase(node* point, const key_type& key)
+{
+	if (point->leaf)
+	{
+		leaf_node* leaf = static_cast<leaf_node*>(point);
+		size_t index = search::lower(leaf->keys, leaf->count, key, key_compare);
+		if (index == leaf->count or key_compare(key, leaf->keys[index]))
+			return false;
+		std::move(leaf->keys + index + 1, leaf->keys + leaf->count, leaf->keys + index);
+		std::move(leaf->values + index + 1, leaf->values + leaf->count, leaf->values + index);
+		--leaf->count;
+		return true;
+	}
+	inner_node* inner = static_cast<inner_node*>(point);
+	size_t index = search::upper(inner->keys, inner->count, key, key_compare);
+	if (not erase(inner->children[index], key))
+		return false;
+	fix_child(inner, index);
+	return true;
+}
+
+/** Erases the pair of key 'key' if such is present in the map.
+* @param const key_type& key - the key of the pair to be erased
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::erase(const key_type& key)
+{
+	if (root == nullptr or not erase(root, key))
+		return;
+	--number_of_pairs;
+	if (root->count == 0)
+	{
+		node* old = root;
+		if (root->leaf)
+		{
+			root = first_leaf = last_leaf = nullptr;
+			delete static_cast<leaf_node*>(old);
+		}
+		else
+		{
+			root = static_cast<inner_node*>(old)->children[0];
+			delete static_cast<inner_node*>(old);
+		}
+	}
+}
+
+/** Returns the pair of the least key. Throws if the map is empty.
+* @return the pair of the least key
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::value_type my_btree<key_type, mapped_type, compare, node_bytes>::min() const
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	return value_type(first_leaf->keys[0], first_leaf->values[0]);
+}
+
+/** Returns the pair of the greatest key. Throws if the map is empty.
+* @return the pair of the greatest key
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::value_type my_btree<key_type, mapped_type, compare, node_bytes>::max() const
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	return value_type(last_leaf->keys[last_leaf->count - 1], last_leaf->values[last_leaf->count - 1]);
+}
+
+/** Returns the iterator to the first pair whose key is not less than 'key'.
+* @param const key_type& key - the bound
+* @return the iterator to the pair or end() if there is no such pair
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::iterator my_btree<key_type, mapped_type, compare, node_bytes>::lower_bound(const key_type& key)
+{
+	leaf_node* leaf = find_leaf(key);
+	if (leaf == nullptr)
+		return end();
+	size_t index = search::lower(leaf->keys, leaf->count, key, key_compare);
+	if (index == leaf->count)
+		return iterator(leaf->next, 0, this);
+	return iterator(leaf, index, this);
+}
+
+/// Constant version of 'lower_bound'.
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::const_iterator my_btree<key_type, mapped_type, compare, node_bytes>::lower_bound(const key_type& key) const
+{
+	return const_cast<my_btree*>(this)->lower_bound(key);
+}
+
+/** Looks for the pair of the key 'key'.
+* @param const key_type& key - the key to be found
+* @return the iterator to the pair or end() if the key is not present
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::iterator my_btree<key_type, mapped_type, compare, node_bytes>::find(const key_type& key)
+{
+	leaf_node* leaf = find_leaf(key);
+	if (leaf == nullptr)
+		return end();
+	size_t index = search::lower(leaf->keys, leaf->count, key, key_compare);
+	if (index == leaf->count or key_compare(key, leaf->keys[index]))
+		return end();
+	return iterator(leaf, index, this);
+}
+
+/// Constant version of 'find'.
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+typename my_btree<key_type, mapped_type, compare, node_bytes>::const_iterator my_btree<key_type, mapped_type, compare, node_bytes>::find(const key_type& key) const
+{
+	return const_cast<my_btree*>(this)->find(key);
+}
+
+/** Checks whether the key 'key' is present in the map.
+* @param const key_type& key - the key to be checked
+* @return true if the key is present, false otherwise
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+bool my_btree<key_type, mapped_type, compare, node_bytes>::contains(const key_type& key) const
+{
+	return find(key) != end();
+}
+
+/** Counts the pairs of the key 'key'.
+* @param const key_type& key - the key to be counted
+* @return 1 if the key is present, 0 otherwise
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+size_t my_btree<key_type, mapped_type, compare, node_bytes>::count(const key_type& key) const
+{
+	return contains(key) ? 1 : 0;
+}
+
+/** Accesses the value assigned to key 'key'. Throws if such key is not present.
+* @param const key_type& key - the key to which the value is assigned
+* @return reference to the value mapped to the key
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+mapped_type& my_btree<key_type, mapped_type, compare, node_bytes>::at(const key_type& key)
+{
+	iterator found = find(key);
+	if (found == end())
+		throw my_exc(root == nullptr ? error_t::empty_map : error_t::out_of_range);
+	return found.leaf->values[found.index];
+}
+
+/// Constant version of 'at'.
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+const mapped_type& my_btree<key_type, mapped_type, compare, node_bytes>::at(const key_type& key) const
+{
+	return const_cast<my_btree*>(this)->at(key);
+}
+
+/** Calls 'function' on every pair whose key lies in [low, high), in the ascending order of keys.
+* @param const key_type& low - the least key of the range
+* @param const key_type& high - the key past the range
+* @param function_type function - callable taking std::pair<const key_type&, const mapped_type&>
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+template <class function_type>
+void my_btree<key_type, mapped_type, compare, node_bytes>::for_each_in_range(const key_type& low, const key_type& high, function_type function) const
+{
+	for (const_iterator it = lower_bound(low); it != end() and key_compare(it.leaf->keys[it.index], high); ++it)
+		function(*it);
+}
+
+/** Builds the tree from the range [first, last) in linear time, bottom up: the pairs are spread evenly over the leaves
+* and the children evenly over the inner nodes. The range has to be sorted in the ascending order of keys and must not contain repeated keys.
+* Throws if the map is not empty.
+* @param iterator_type first - the forward iterator to the first pair
+* @param iterator_type last - the iterator past the last pair
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+template <class iterator_type>
+void my_btree<key_type, mapped_type, compare, node_bytes>::build(iterator_type first, iterator_type last)
+{
+	if (root != nullptr)
+		throw my_exc(error_t::non_empty_map);
+	size_t count = std::distance(first, last);
+	if (count == 0)
+		return;
+	std::vector<std::pair<node*, key_type>> level;
+	size_t leaves = (count + leaf_capacity - 1) / leaf_capacity;
+	leaf_node* previous = nullptr;
+	for (size_t i = 0; i < leaves; ++i)
+	{
+		leaf_node* leaf = new leaf_node;
+		leaf->count = count / leaves + (i < count % leaves ? 1 : 0);
+		for (size_t j = 0; j < leaf->count; ++j, ++first)
+		{
+			leaf->keys[j] = first->first;
+			leaf->values[j] = first->second;
+		}
+		leaf->previous = previous;
+		if (previous != nullptr)
+			previous->next = leaf;
+		else
+			first_leaf = leaf;
+		previous = leaf;
+		level.emplace_back(leaf, leaf->keys[0]);
+	}
+	last_leaf = previous;
+	while (level.size() > 1)
+	{
+		std::vector<std::pair<node*, key_type>> upper;
+		size_t nodes = (level.size() + inner_capacity) / (inner_capacity + 1);
+		for (size_t i = 0, taken = 0; i < nodes; ++i)
+		{
+			inner_node* inner = new inner_node;
+			size_t children = level.size() / nodes + (i < level.size() % nodes ? 1 : 0);
+			for (size_t j = 0; j < children; ++j)
+			{
+				inner->children[j] = level[taken + j].first;
+				if (j > 0)
+					inner->keys[j - 1] = level[taken + j].second;
+			}
+			inner->count = children - 1;
+			upper.emplace_back(inner, std::move(level[taken].second));
+			taken += children;
+		}
+		level.swap(upper);
+	}
+	root = level[0].first;
+	number_of_pairs = count;
+}
+
+/** Serializes the contents of the map to the file 'name', in the ascending order of keys, in the format of my_map::serialize.
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::serialize(const std::string& name) const
+{
+	std::ofstream file;
+	file.open(name, std::ios::out);
+	if (file.good())
+		for (leaf_node* leaf = first_leaf; leaf != nullptr; leaf = leaf->next)
+			for (size_t i = 0; i < leaf->count; ++i)
+				file << leaf->keys[i] << ' ' << leaf->values[i] << '\n';
+	file.close();
+}
+
+/** Deserializes the contents of the file 'name', written by 'serialize', into the map. An empty map is built in linear time;
+* into a non-empty one the pairs are inserted one by one, the present pairs take precedence.
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template <class key_type, class mapped_type, class compare, size_t node_bytes>
+void my_btree<key_type, mapped_type, compare, node_bytes>::deserialize(const std::string& name)
+{
+	std::vector<value_type> values;
+	if (not read_text_pairs(name, values))
+		return;
+	if (root != nullptr)
+	{
+		for (const value_type& item : values)
+			insert(item);
+		return;
+	}
+	auto key_less = [this](const value_type& a, const value_type& b) { return key_compare(a.first, b.first); };
+	auto key_equal = [this](const value_type& a, const value_type& b) { return not key_compare(a.first, b.first) and not key_compare(b.first, a.first); };
+	if (not std::is_sorted(values.begin(), values.end(), key_less))
+		std::stable_sort(values.begin(), values.end(), key_less);
+	values.erase(std::unique(values.begin(), values.end(), key_equal), values.end());
+	build(values.begin(), values.end());
+}
@@ -0,0 +1,223 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "my_map.cpp"
+
+/// Counts the readers present in one instance of my_concurrent_map. The counters are spread over cache lines, so that readers
+/// running on different cores do not contend for a single one.
+class read_indicator
+{
+	static constexpr size_t number_of_slots = 64;
+	struct alignas(64) counter
+	{
+		std::atomic<long> value{ 0 };
+	};
+	counter counters[number_of_slots];
+public:
+	/// Returns the slot of the calling thread, fixed for the lifetime of the thread.
+	static size_t slot()
+	{
+		thread_local size_t own = std::hash<std::thread::id>()(std::this_thread::get_id()) % number_of_slots;
+		return own;
+	}
+	void arrive(size_t slot) { counters[slot].value.fetch_add(1); }
+	void depart(size_t slot) { counters[slot].value.fetch_sub(1); }
+	bool empty() const
+	{
+		for (const counter& item : counters)
+			if (item.value.load() != 0)
+				return false;
+		return true;
+	}
+};
+
+/** Map shared by many threads, in which readers never block. It keeps two instances of my_map and follows the Left-Right protocol:
+* readers announce themselves in a read indicator and use the instance currently published, without any lock;
+* a writer modifies the other instance, publishes it, waits until no reader is left in the old one and repeats the modification there.
+* Since a writer never touches an instance that a reader may be in, the nodes freed by 'erase' and by the rebalancing
+* are reclaimed at once, with no deferred reclamation. Writers are serialized by a mutex; 'write' applies a whole batch per publication.
+* The price is twice the memory and twice the work of every modification.
+* @param key_type - the type used as the key
+* @param mapped_type - the type of data assigned to the keys
+* @param compare - the ordering of the keys, std::less<key_type> by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>>
+class my_concurrent_map
+{
+public:
+	using map_type = my_map<key_type, mapped_type, compare>;
+	using value_type = typename map_type::value_type;
+private:
+	map_type instances[2];
+	std::atomic<int> published{ 0 };
+	std::atomic<int> version{ 0 };
+	mutable read_indicator indicators[2];
+	std::mutex writer;
+	void wait_for_readers();
+public:
+	my_concurrent_map() = default;
+	my_concurrent_map(const my_concurrent_map&) = delete;
+	my_concurrent_map& operator=(const my_concurrent_map&) = delete;
+
+	template <class function_type>
+	auto read(function_type function) const -> decltype(function(std::declval<const map_type&>()));
+	template <class function_type>
+	void write(function_type function);
+
+	bool find(const key_type& key, mapped_type& value) const;
+	bool contains(const key_type& key) const;
+	mapped_type at(const key_type& key) const;
+	size_t size() const;
+	bool empty() const;
+	template <class function_type>
+	void for_each_in_range(const key_type& low, const key_type& high, function_type function) const;
+
+	void insert(const value_type& value);
+	void erase(const key_type& key);
+};
+
+/** Runs 'function' on the currently published instance. Never blocks: the reader only marks its presence in the read indicator.
+* The references obtained inside 'function' must not be used after it returns.
+* @param function_type function - callable taking const my_map<key_type, mapped_type, compare>&
+* @return the result of 'function'
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+auto my_concurrent_map<key_type, mapped_type, compare>::read(function_type function) const -> decltype(function(std::declval<const map_type&>()))
+{
+	struct presence
+	{
+		read_indicator& indicator;
+		size_t slot;
+		presence(read_indicator& _indicator) : indicator(_indicator), slot(read_indicator::slot()) { indicator.arrive(slot); }
+		~presence() { indicator.depart(slot); }
+	} guard(indicators[version.load()]);
+	return function(instances[published.load()]);
+}
+
+/** Applies 'function' to both instances, one after the other, so that readers always see a consistent version.
+* 'function' is called twice and must make the same changes both times; if it throws, the instances may differ.
+* Concurrent writers are serialized.
+* @param function_type function - callable taking my_map<key_type, mapped_type, compare>&
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+void my_concurrent_map<key_type, mapped_type, compare>::write(function_type function)
+{
+	std::lock_guard<std::mutex> lock(writer);
+	int current = published.load();
+	function(instances[1 - current]);
+	published.store(1 - current);
+	wait_for_readers();
+	function(instances[current]);
+}
+
+/** Toggles the version of the read indicators and waits until every reader that could have seen the previously published instance has left it.
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_concurrent_map<key_type, mapped_type, compare>::wait_for_readers()
+{
+	int previous = version.load(), next = 1 - previous;
+	while (not indicators[next].empty())
+		std::this_thread::yield();
+	version.store(next);
+	while (not indicators[previous].empty())
+		std::this_thread::yield();
+}
+
+/** Looks for the key 'key' and copies its mapped value. Never blocks nor throws on a miss.
+* @param const key_type& key - the key to be found
+* @param mapped_type& value - receives the mapped value if the key is present
+* @return true if the key is present, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_concurrent_map<key_type, mapped_type, compare>::find(const key_type& key, mapped_type& value) const
+{
+	return read([&](const map_type& map)
+		{
+			auto found = map.find(key);
+			if (found == map.end())
+				return false;
+			value = found->second;
+			return true;
+		});
+}
+
+/** Checks whether the key 'key' is present in the map.
+* @param const key_type& key - the key to be checked
+* @return true if the key is present, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_concurrent_map<key_type, mapped_type, compare>::contains(const key_type& key) const
+{
+	return read([&](const map_type& map) { return map.contains(key); });
+}
+
+/** Returns a copy of the value assigned to key 'key'. Throws if such key is not present.
+* @param const key_type& key - the key to which the value is assigned
+* @return the value mapped to the key
+*/
+template <class key_type, class mapped_type, class compare>
+mapped_type my_concurrent_map<key_type, mapped_type, compare>::at(const key_type& key) const
+{
+	return read([&](const map_type& map) { return map.at(key); });
+}
+
+/** Returns the number of pairs in the published instance.
+* @return the number of pairs
+*/
+template <class key_type, class mapped_type, class compare>
+size_t my_concurrent_map<key_type, mapped_type, compare>::size() const
+{
+	return read([](const map_type& map) { return map.size(); });
+}
+
+/** Returns the information whether the map is empty.
+* @return true if the map is empty, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_concurrent_map<key_type, mapped_type, compare>::empty() const
+{
+	return read([](const map_type& map) { return map.empty(); });
+}
+
+/** Calls 'function' on every pair whose key lies in [low, high), in the ascending order of keys, all from one consistent version.
+* Writers wait for the scan to finish before they modify the instance it reads.
+* @param const key_type& low - the least key of the range
+* @param const key_type& high - the key past the range
+* @param function_type function - callable taking const std::pair<key_type, mapped_type>&
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+void my_concurrent_map<key_type, mapped_type, compare>::for_each_in_range(const key_type& low, const key_type& high, function_type function) const
+{
+	read([&](const map_type& map) { map.for_each_in_range(low, high, function); });
+}
+
+/** Performs insertion into the map.
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_concurrent_map<key_type, mapped_type, compare>::insert(const value_type& value)
+{
+	write([&](map_type& map) { map.insert(value); });
+}
+
+/** Erases the pair of key 'key' if such is present in the map.
+* @param const key_type& key - the key of the pair to be erased
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_concurrent_map<key_type, mapped_type, compare>::erase(const key_type& key)
+{
+	write([&](map_type& map) { map.erase(key); });
+}
@@ -0,0 +1,350 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "my_map.cpp"
+
+/// Header of the write-ahead log of my_durable_map. It is followed by the records, each made of a kind byte, the key,
+/// the mapped value for an insertion, and the lower half of the FNV-1a checksum of the preceding bytes of the record.
+struct log_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t key_size;
+	uint32_t mapped_size;
+};
+
+const char LOG_MAGIC[8] = { 'M', 'Y', 'M', 'A', 'P', 'W', 'A', 'L' };
+const uint32_t LOG_VERSION = 1;
+const unsigned char LOG_INSERT = 1, LOG_ERASE = 2;
+
+/// Settings of the durability of my_durable_map.
+struct durability_options
+{
+	/// The number of buffered records written and flushed together, so that one flush serves a whole group of updates.
+	size_t group_size = 1024;
+	/// The longest time a record may wait in the buffer, checked on every update; zero leaves the flush to 'group_size' and 'commit' only.
+	std::chrono::microseconds group_delay = std::chrono::microseconds(2000);
+	/// The size of the log in bytes after which a checkpoint is taken on the next flush; zero disables automatic checkpoints.
+	uint64_t checkpoint_bytes = uint64_t(64) << 20;
+	/// Whether every flush forces the records to the disk with fsync; otherwise they only reach the operating system.
+	bool sync = true;
+};
+
+/** Forces the written contents of 'file' to the disk.
+* @param std::FILE* file - the file, already flushed
+* @return true on success, false otherwise
+*/
+inline bool sync_file(std::FILE* file)
+{
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+/** Renames the file 'source' to 'target', replacing 'target' in one step, so that a crash leaves one of the two files under the name 'target'.
+* With 'sync' the rename is forced to the disk before returning (on POSIX by syncing the directory), so it cannot be overtaken by later changes to the directory.
+* @param const std::string& source - the name of the file to be renamed
+* @param const std::string& target - the new name, of a file in the same directory
+* @param bool sync - whether the rename should be forced to the disk
+* @return true on success, false otherwise
+*/
+inline bool replace_file(const std::string& source, const std::string& target, bool sync)
+{
+#ifdef _WIN32
+	return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | (sync ? MOVEFILE_WRITE_THROUGH : 0)) != 0;
+#else
+	if (std::rename(source.c_str(), target.c_str()) != 0)
+		return false;
+	if (not sync)
+		return true;
+	size_t slash = target.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : target.substr(0, slash);
+	int descriptor = open(directory.c_str(), O_RDONLY);
+	if (descriptor < 0)
+		return false;
+	bool synced = fsync(descriptor) == 0;
+	close(descriptor);
+	return synced;
+#endif
+}
+
+/** Map kept durable by an append-only write-ahead log next to a binary snapshot, the checkpoint. Every effective 'insert' and 'erase'
+* is applied in memory and appended to a buffer; the buffer is written and flushed as one group (group commit), so a crash loses
+* at most the updates not yet flushed. A checkpoint saves the whole map with 'save_snapshot' and truncates the log; on opening,
+* the log is replayed onto the checkpoint. Replaying a log onto a checkpoint that already contains its updates gives the same map,
+* so a crash between writing a checkpoint and truncating the log does no harm.
+* @param key_type - the type used as the key, trivially copyable
+* @param mapped_type - the type of data assigned to the keys, trivially copyable
+* @param compare - the ordering of the keys, std::less<key_type> by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>>
+class my_durable_map
+{
+	static_assert(std::is_trivially_copyable<key_type>::value and std::is_trivially_copyable<mapped_type>::value,
+		"The write-ahead log requires trivially copyable keys and mapped values.");
+public:
+	using map_type = my_map<key_type, mapped_type, compare>;
+	using value_type = typename map_type::value_type;
+private:
+	map_type map;
+	std::string snapshot_name, log_name;
+	durability_options options;
+	std::FILE* log = nullptr;
+	std::vector<char> buffer;
+	size_t buffered = 0;
+	uint64_t log_bytes = 0;
+	std::chrono::steady_clock::time_point oldest;
+	void open_log();
+	bool replay();
+	void append(unsigned char kind, const key_type& key, const mapped_type* mapped);
+public:
+	explicit my_durable_map(const std::string& name, const durability_options& _options = durability_options());
+	my_durable_map(const my_durable_map&) = delete;
+	my_durable_map& operator=(const my_durable_map&) = delete;
+	~my_durable_map();
+
+	void insert(const value_type& value);
+	void erase(const key_type& key);
+	void commit();
+	void checkpoint();
+
+	/// Returns the map for reading; all the updates have to go through 'insert' and 'erase'.
+	const map_type& contents() const { return map; }
+	bool contains(const key_type& key) const { return map.contains(key); }
+	const mapped_type& at(const key_type& key) const { return map.at(key); }
+	size_t size() const { return map.size(); }
+	bool empty() const { return map.empty(); }
+	/// Returns the number of bytes of the log, including the buffered records.
+	uint64_t log_size() const { return log_bytes + buffer.size(); }
+};
+
+/** Constructor of class my_durable_map<key_type, mapped_type, compare>. Recovers the map from the checkpoint 'name'.snapshot and the log 'name'.log,
+* if they exist; a record torn by a crash ends the replay. A replayed log is compacted into a new checkpoint at once.
+* Throws if the files are damaged or written for other types.
+* @param const std::string& name - the common name of the files
+* @param const durability_options& _options - the settings of the durability
+*/
+template <class key_type, class mapped_type, class compare>
+my_durable_map<key_type, mapped_type, compare>::my_durable_map(const std::string& name, const durability_options& _options)
+	: snapshot_name(name + ".snapshot"), log_name(name + ".log"), options(_options)
+{
+	if (std::ifstream(snapshot_name).good())
+		map.load_snapshot(snapshot_name);
+	if (replay())
+		checkpoint();
+	else
+		open_log();
+}
+
+/// Destructor of class my_durable_map<key_type, mapped_type, compare>. Flushes the buffered records and closes the log; errors are ignored.
+template <class key_type, class mapped_type, class compare>
+my_durable_map<key_type, mapped_type, compare>::~my_durable_map()
+{
+	try
+	{
+		commit();
+	}
+	catch (...)
+	{
+	}
+	if (log != nullptr)
+		std::fclose(log);
+}
+
+/** Reads the log and applies its records to the map, up to the end of the file or to the first torn record.
+* @return true if the log holds at least one record or a torn tail, false if it is missing or holds the header only
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_durable_map<key_type, mapped_type, compare>::replay()
+{
+	std::ifstream file(log_name, std::ios::in | std::ios::binary);
+	if (not file.good())
+		return false;
+	std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	log_header header;
+	if (contents.size() < sizeof(header))
+		return not contents.empty();
+	std::memcpy(&header, contents.data(), sizeof(header));
+	if (std::memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0 or header.version != LOG_VERSION
+		or header.byte_order != SNAPSHOT_BYTE_ORDER or header.key_size != sizeof(key_type) or header.mapped_size != sizeof(mapped_type))
+		throw my_exc(error_t::bad_file);
+	size_t position = sizeof(header);
+	while (position < contents.size())
+	{
+		unsigned char kind = static_cast<unsigned char>(contents[position]);
+		size_t length = 1 + sizeof(key_type) + (kind == LOG_INSERT ? sizeof(mapped_type) : 0);
+		uint32_t sum;
+		if ((kind != LOG_INSERT and kind != LOG_ERASE) or contents.size() - position < length + sizeof(sum))
+			break;
+		std::memcpy(&sum, contents.data() + position + length, sizeof(sum));
+		if (sum != static_cast<uint32_t>(snapshot_checksum(contents.data() + position, length)))
+			break;
+		value_type value;
+		std::memcpy(&value.first, contents.data() + position + 1, sizeof(key_type));
+		if (kind == LOG_INSERT)
+		{
+			std::memcpy(&value.second, contents.data() + position + 1 + sizeof(key_type), sizeof(mapped_type));
+			map.insert(value);
+		}
+		else
+			map.erase(value.first);
+		position += length + sizeof(sum);
+	}
+	return contents.size() > sizeof(header);
+}
+
+/** Creates the log anew, with the header only, or opens the present one for appending.
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_durable_map<key_type, mapped_type, compare>::open_log()
+{
+	if (log != nullptr)
+		std::fclose(log);
+	log = std::fopen(log_name.c_str(), "ab");
+	if (log == nullptr)
+		throw my_exc(error_t::bad_file);
+	std::fseek(log, 0, SEEK_END);
+	long length = std::ftell(log);
+	if (length < 0)
+		throw my_exc(error_t::bad_file);
+	log_bytes = static_cast<uint64_t>(length);
+	if (log_bytes == 0)
+	{
+		log_header header{};
+		std::memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+		header.version = LOG_VERSION;
+		header.byte_order = SNAPSHOT_BYTE_ORDER;
+		header.key_size = sizeof(key_type);
+		header.mapped_size = sizeof(mapped_type);
+		if (std::fwrite(&header, sizeof(header), 1, log) != 1 or std::fflush(log) != 0 or (options.sync and not sync_file(log)))
+			throw my_exc(error_t::bad_file);
+		log_bytes = sizeof(header);
+	}
+}
+
+/** Appends a record to the buffer and flushes the buffer if the group is full or its oldest record has waited long enough.
+* @param unsigned char kind - LOG_INSERT or LOG_ERASE
+* @param const key_type& key - the key
+* @param const mapped_type* mapped - the pointer to the mapped value of an insertion, nullptr for an erasure
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_durable_map<key_type, mapped_type, compare>::append(unsigned char kind, const key_type& key, const mapped_type* mapped)
+{
+	size_t start = buffer.size(), length = 1 + sizeof(key_type) + (mapped != nullptr ? sizeof(mapped_type) : 0);
+	buffer.resize(start + length + sizeof(uint32_t));
+	buffer[start] = static_cast<char>(kind);
+	std::memcpy(buffer.data() + start + 1, &key, sizeof(key_type));
+	if (mapped != nullptr)
+		std::memcpy(buffer.data() + start + 1 + sizeof(key_type), mapped, sizeof(mapped_type));
+	uint32_t sum = static_cast<uint32_t>(snapshot_checksum(buffer.data() + start, length));
+	std::memcpy(buffer.data() + start + length, &sum, sizeof(sum));
+	if (buffered++ == 0 and options.group_delay.count() != 0)
+		oldest = std::chrono::steady_clock::now();
+	if (buffered >= options.group_size
+		or (options.group_delay.count() != 0 and std::chrono::steady_clock::now() - oldest >= options.group_delay))
+		commit();
+}
+
+/** Inserts 'value' into the map and logs the insertion, unless the key is already present.
+* If the log cannot be written, the insertion stays in memory only and the exception is thrown.
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_durable_map<key_type, mapped_type, compare>::insert(const value_type& value)
+{
+	if (map.insert(value).second)
+		append(LOG_INSERT, value.first, &value.second);
+}
+
+/** Erases the pair of key 'key' from the map and logs the erasure, if the key is present.
+* @param const key_type& key - the key of the pair to be erased
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_durable_map<key_type, mapped_type, compare>::erase(const key_type& key)
+{
+	if (map.extract(key))
+		append(LOG_ERASE, key, nullptr);
+}
+
+/** Writes the buffered records to the log and flushes them, making all the updates so far durable. Takes a checkpoint
+* if the log has outgrown 'checkpoint_bytes'. Throws if the log cannot be written.
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_durable_map<key_type, mapped_type, compare>::commit()
+{
+	if (buffer.empty())
+		return;
+	if (std::fwrite(buffer.data(), 1, buffer.size(), log) != buffer.size() or std::fflush(log) != 0 or (options.sync and not sync_file(log)))
+		throw my_exc(error_t::bad_file);
+	log_bytes += buffer.size();
+	buffer.clear();
+	buffered = 0;
+	if (options.checkpoint_bytes != 0 and log_bytes >= options.checkpoint_bytes)
+		checkpoint();
+}
+
+/** Saves the whole map as the new checkpoint and truncates the log. The snapshot is written to a temporary file, forced to the disk
+* and renamed over the previous one, so that a crash leaves either checkpoint intact; the rename reaches the disk before the log is removed.
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_durable_map<key_type, mapped_type, compare>::checkpoint()
+{
+	if (log != nullptr and not buffer.empty())
+	{
+		if (std::fwrite(buffer.data(), 1, buffer.size(), log) != buffer.size() or std::fflush(log) != 0)
+			throw my_exc(error_t::bad_file);
+		buffer.clear();
+		buffered = 0;
+	}
+	std::string temporary = snapshot_name + ".tmp";
+	map.save_snapshot(temporary);
+	if (options.sync)
+	{
+		std::FILE* written = std::fopen(temporary.c_str(), "rb+");
+		bool synced = written != nullptr and sync_file(written);
+		if (written != nullptr)
+			std::fclose(written);
+		if (not synced)
+			throw my_exc(error_t::bad_file);
+	}
+	if (not replace_file(temporary, snapshot_name, options.sync))
+		throw my_exc(error_t::bad_file);
+	if (log != nullptr)
+	{
+		std::fclose(log);
+		log = nullptr;
+	}
+	std::remove(log_name.c_str());
+	open_log();
+}
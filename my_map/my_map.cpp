@@ -1,11 +1,33 @@
 #pragma once
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <iostream>
 
+#if (defined(_M_X64) || defined(_M_IX86)) && !defined(__GNUC__)
+#include <xmmintrin.h>
+#endif
+
+#include "mapped_file.cpp"
+#include "pool_allocator.cpp"
+
 /// Passed as argument to the constructor of exception class 'my_exc'.
 enum class error_t
 {
@@ -18,7 +40,8 @@ enum class error_t
 	out_of_range,
 	bad_file,
 	no_predecessor,
-	no_successor
+	no_successor,
+	overlapping_ranges
 };
 
 /// Exception class.
@@ -51,6 +74,8 @@ public:
 			return "No predecessor.";
 		case error_t::no_successor:
 			return "No successor.";
+		case error_t::overlapping_ranges:
+			return "The keys of the joined maps overlap.";
 		default:
 			return "Unknown problem.";
 		}
@@ -62,583 +87,3759 @@ const colour_t RED = 0, BLACK = 1, DOUBLE_BLACK = 2;
 using dir_t = int8_t;
 const dir_t LEFT = 0, RIGHT = 1, ROOT = 2;
 
-/** Implementation of a map as a red-black tree.
-* @param key_type - the type used as the key
-* @mapped_type - the type of data assigned to the keys
+/** Header of the binary snapshot file written by 'my_map::save_snapshot'. It is followed by the array of records sorted by key,
+* starting at 'records_offset', and optionally by one checksum per block of 'records_per_block' records, starting at 'checksums_offset'.
+* All the numbers are stored in the byte order of the machine that wrote the file, which is checked with 'byte_order'.
+*/
+struct snapshot_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t flags;
+	uint32_t key_size;
+	uint32_t mapped_size;
+	uint32_t record_size;
+	uint64_t count;
+	uint64_t records_per_block;
+	uint64_t records_offset;
+	uint64_t checksums_offset;
+};
+const char SNAPSHOT_MAGIC[8] = { 'M', 'Y', 'M', 'A', 'P', 'S', 'N', 'P' };
+const uint32_t SNAPSHOT_VERSION = 1, SNAPSHOT_BYTE_ORDER = 0x01020304, SNAPSHOT_CHECKSUMS = 1;
+const uint64_t SNAPSHOT_RECORDS_PER_BLOCK = 4096;
+/// The set operations of my_map recurse in parallel only into subtrees of at least this black height, i.e. of at least 2^PARALLEL_MIN_BLACK_HEIGHT - 1 nodes.
+/// The balancing policies other than red-black scale their 'parallel_rank' from it.
+const unsigned PARALLEL_MIN_BLACK_HEIGHT = 10;
+/// The size of the buffer of the file stream used by 'my_map::serialize_async'.
+const size_t SERIALIZE_BUFFER_BYTES = size_t(1) << 20;
+/// A batch passed to 'my_map::insert_batch' or 'my_map::erase_batch' of at least 1 / BATCH_REBUILD_RATIO of the size of the map rebuilds the tree.
+const size_t BATCH_REBUILD_RATIO = 4;
+/// The least size in bytes of the chunk of a text file parsed by a thread of its own in 'read_text_pairs'.
+const size_t TEXT_CHUNK_BYTES = size_t(1) << 20;
+/// The number of descents 'my_map::find_many' advances in lock-step; enough outstanding cache misses to keep the memory system busy.
+const size_t FIND_MANY_LANES = 16;
+
+/** Hints the processor to load the cache line of 'address' ahead of its use. Does nothing where no such hint is available.
+* @param const void* address - the address, which need not be valid
+* @return void
 */
+inline void prefetch_line(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address);
+#elif defined(_M_X64) || defined(_M_IX86)
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+	(void)address;
+#endif
+}
+
+/// A single pair as it is stored in the binary snapshot file.
 template <class key_type, class mapped_type>
-class my_map
+struct snapshot_record
 {
-	using value_type = std::pair<key_type, mapped_type>;
-	struct node
+	key_type first;
+	mapped_type second;
+};
+
+/** Computes the 64-bit FNV-1a checksum of 'size' bytes starting at 'data'.
+* @param const void* data - the pointer to the bytes
+* @param size_t size - the number of bytes
+* @return the checksum
+*/
+inline uint64_t snapshot_checksum(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
 	{
-		value_type data;
-		colour_t colour;
-		std::shared_ptr<node> parent, child[2];
-		node();
-		node(value_type _data, std::shared_ptr<node> _parent = nullptr);
-	};
-	std::shared_ptr<node> root;
-	size_t number_of_nodes;
-	inline dir_t which_child(std::shared_ptr<node> point);
-	void rotation(std::shared_ptr<node> point, dir_t dir);
-	std::shared_ptr<node> predecessor(std::shared_ptr<node> point);
-	std::shared_ptr<node> successor(std::shared_ptr<node> point);
-	void print_node(std::shared_ptr<node> point, unsigned& level, unsigned& black_depth, dir_t& dir);
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
 
+/** Header of the compressed snapshot file written by 'my_map::save_compressed'. It is followed by the blocks of 'pairs_per_block' pairs
+* and by the block index of 'blocks' entries at 'index_offset'. Within a block every key is stored as the zigzag varint of its difference
+* from the previous one, the first from the key in the index, and is followed by its mapped value encoded by the value codec 'codec'.
+*/
+struct compressed_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t key_size;
+	uint32_t codec;
+	uint64_t count;
+	uint64_t pairs_per_block;
+	uint64_t blocks;
+	uint64_t index_offset;
+};
+/// An entry of the block index of a compressed snapshot: the first key of the block, the offset of the block and the checksum of its bytes.
+struct compressed_block
+{
+	uint64_t first_key;
+	uint64_t offset;
+	uint64_t checksum;
+};
+const char COMPRESSED_MAGIC[8] = { 'M', 'Y', 'M', 'A', 'P', 'C', 'M', 'P' };
+const uint32_t COMPRESSED_VERSION = 1;
+const uint64_t COMPRESSED_PAIRS_PER_BLOCK = 256;
 
-public:
-	my_map();
-	my_map(my_map&& other);
-	void insert(value_type value);
-private:
-	void resolve_double_black(std::shared_ptr<node>& point);
-	void erase(std::shared_ptr<node>& point);
-public:
-	void erase(const key_type& key);
-	value_type max();
-	value_type min();
-	mapped_type& at(key_type key);
-private:
-	void serialize(std::shared_ptr<node> point, std::ofstream& file);
-public:
-	void serialize(const std::string& name);
-	void deserialize(const std::string& name);
-	bool empty();
+/** Appends 'number' to 'out' as a varint: seven bits per byte, the lowest first, the high bit set on all the bytes but the last.
+* @param uint64_t number - the number
+* @param std::vector<unsigned char>& out - the buffer
+* @return void
+*/
+inline void put_varint(uint64_t number, std::vector<unsigned char>& out)
+{
+	while (number >= 0x80)
+	{
+		out.push_back(static_cast<unsigned char>(number | 0x80));
+		number >>= 7;
+	}
+	out.push_back(static_cast<unsigned char>(number));
+}
 
-	void print();
+/** Reads a varint written by 'put_varint' and advances 'in' past it.
+* @param const unsigned char*& in - the position of the varint
+* @param const unsigned char* end - the end of the readable bytes
+* @param uint64_t& number - receives the number
+* @return true on success, false if the varint is truncated or too long
+*/
+inline bool get_varint(const unsigned char*& in, const unsigned char* end, uint64_t& number)
+{
+	number = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7)
+	{
+		if (in == end)
+			return false;
+		unsigned char byte = *in++;
+		number |= uint64_t(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
 
-	class iterator
+/// Maps a signed difference to an unsigned number so that differences of small magnitude, of either sign, get short varints.
+inline uint64_t zigzag(uint64_t difference) { return (difference << 1) ^ (0 - (difference >> 63)); }
+/// Inverse of 'zigzag'.
+inline uint64_t unzigzag(uint64_t number) { return (number >> 1) ^ (0 - (number & 1)); }
+
+/// Value codec of compressed snapshots copying the bytes of trivially copyable mapped values.
+struct raw_codec
+{
+	static constexpr uint32_t id = 1;
+	template <class mapped_type>
+	static void encode(const mapped_type& value, std::vector<unsigned char>& out)
 	{
-		std::shared_ptr<node> my_node;
-		iterator(std::shared_ptr<node> _my_node) : my_node(_my_node) {}
-	public:
-		iterator() {}
-		value_type operator*() { return my_node->data; }
-		iterator& operator++()
-		{
-			try { my_node = successor(my_node); }
-			catch (...) { my_node = nullptr; }
-			return *this;
-		}
-		iterator& operator--()
-		{
-			try { my_node = predecessor(my_node); }
-			catch (...)
-			{
-				my_node = root;
-				while (my_node->child[RIGHT] != nullptr)
-					my_node = my_node->child[RIGHT];
-			}
-			return *this;
-		}
-		// iterator operator++(int); ?
-		// iterator operator--(int); ?
-		bool operator=(value_type value) { *my_node = value; }
-		bool operator=(iterator other) { my_node = other.my_node; }
-		bool operator==(iterator other) { return my_node == other.my_node; }
-		bool operator!=(iterator other) { return my_node == other.my_node; }
-		iterator begin() const
-		{
-			if (root == nullptr) return iterator(nullptr);
-			std::shared_ptr<node> ptr = root;
-			while (ptr.child[LEFT] != nullptr) ptr = ptr->child[LEFT];
-			return iterator(ptr);
-		}
-		iterator end() const { return iterator(nullptr); }
-	};
+		static_assert(std::is_trivially_copyable<mapped_type>::value, "raw_codec requires trivially copyable mapped values.");
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(mapped_type));
+	}
+	template <class mapped_type>
+	static bool decode(const unsigned char*& in, const unsigned char* end, mapped_type& value)
+	{
+		if (size_t(end - in) < sizeof(mapped_type))
+			return false;
+		std::memcpy(&value, in, sizeof(mapped_type));
+		in += sizeof(mapped_type);
+		return true;
+	}
 };
 
-/** Checks the node indicated by 'point' whether it is its parent's right or left child.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node> point - the shared pointer to the node to be checked
-* @return constant value of type int8_t: LEFT (0) or RIGHT (1) denoting which child the node is
-* or ROOT (2) if the node has no parent
+/// Value codec of compressed snapshots storing integral mapped values as zigzag varints, so that small values of either sign take few bytes.
+struct varint_codec
+{
+	static constexpr uint32_t id = 2;
+	template <class mapped_type>
+	static void encode(const mapped_type& value, std::vector<unsigned char>& out)
+	{
+		static_assert(std::is_integral<mapped_type>::value, "varint_codec requires integral mapped values.");
+		put_varint(zigzag(static_cast<uint64_t>(value)), out);
+	}
+	template <class mapped_type>
+	static bool decode(const unsigned char*& in, const unsigned char* end, mapped_type& value)
+	{
+		uint64_t number;
+		if (not get_varint(in, end, number))
+			return false;
+		value = static_cast<mapped_type>(unzigzag(number));
+		return true;
+	}
+};
+
+/// Result of an asynchronous serialization.
+struct serialize_report
+{
+	/// The size of the written file in bytes.
+	uint64_t bytes = 0;
+	size_t pairs = 0;
+	/// The time the caller was held capturing the contents, in seconds.
+	double capture_seconds = 0.0;
+	/// The time of writing the file on the background thread, in seconds.
+	double write_seconds = 0.0;
+};
+
+/** Writes the pairs of the range [first, last) to the file 'name' in the format of 'my_map::serialize', through a large buffer.
+* Throws if the file cannot be written.
+* @param const std::string& name - the name of the file
+* @param iterator_type first - the iterator to the first pair
+* @param iterator_type last - the iterator past the last pair
+* @return the report with the size of the file, the number of pairs and the time of writing
 */
-template<class key_type, class mapped_type>
-inline dir_t my_map<key_type, mapped_type>::which_child(std::shared_ptr<node> point)
+template <class iterator_type>
+serialize_report write_pairs(const std::string& name, iterator_type first, iterator_type last)
 {
-	return
-		point != root ? (point->parent->child[LEFT] == point ? LEFT : RIGHT) : ROOT;
+	auto begin = std::chrono::steady_clock::now();
+	serialize_report report;
+	std::vector<char> buffer(SERIALIZE_BUFFER_BYTES);
+	std::ofstream file;
+	file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+	file.open(name, std::ios::out);
+	if (not file.good())
+		throw my_exc(error_t::bad_file);
+	for (; first != last; ++first, ++report.pairs)
+		file << first->first << ' ' << first->second << '\n';
+	report.bytes = static_cast<uint64_t>(file.tellp());
+	file.close();
+	if (file.fail())
+		throw my_exc(error_t::bad_file);
+	report.write_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return report;
 }
 
-/** Performs a rotation on the node pointed by 'point' in direction 'dir'.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node> point - the pointer to the node the rotation should be performed on
-* @param int8_t dir - the direction of rotation: LEFT (0) or RIGHT (1)
+/// Tells whether 'c' separates the fields of the text format of 'my_map::serialize', as whitespace does for operator>>.
+inline bool is_text_space(char c)
+{
+	return c == ' ' or c == '\n' or c == '\t' or c == '\r' or c == '\v' or c == '\f';
+}
+
+/** Parses one field of the text format of 'my_map::serialize' from [in, end), skipping the whitespace before it.
+* Integral types other than the character types and floating-point types are parsed by std::from_chars, independently of the locale,
+* std::string takes the characters up to the next whitespace, any other type is read from the field by operator>>.
+* @param const char*& in - the position in the text, moved past the field
+* @param const char* end - the end of the text
+* @param value_type& value - receives the value
+* @return true if a value has been parsed, false if there is no field or it is malformed
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::rotation(std::shared_ptr<node> point, dir_t dir)
+template <class value_type>
+bool parse_text_field(const char*& in, const char* end, value_type& value)
 {
-	if (point == nullptr)
-		throw my_exc(error_t::rotation_on_nullptr);
-	if (dir != LEFT and dir != RIGHT)
-		throw my_exc(error_t::wrong_direction);
-	if (point->child[1 - dir] == nullptr)
+	while (in != end and is_text_space(*in))
+		++in;
+	const char* first = in;
+	while (in != end and not is_text_space(*in))
+		++in;
+	if (first == in)
+		return false;
+	constexpr bool character = std::is_same<value_type, bool>::value or std::is_same<value_type, char>::value
+		or std::is_same<value_type, signed char>::value or std::is_same<value_type, unsigned char>::value;
+	if constexpr ((std::is_integral<value_type>::value and not character) or std::is_floating_point<value_type>::value)
 	{
-		if (dir == LEFT)
-			throw my_exc(error_t::left_rotation_impossible);
-		else
-			throw my_exc(error_t::right_rotation_impossible);
+		if (*first == '+' and in - first > 1 and first[1] != '-')
+			++first;
+		std::from_chars_result result = std::from_chars(first, in, value);
+		return result.ec == std::errc() and result.ptr == in;
 	}
-	if (point == root)
+	else if constexpr (std::is_same<value_type, std::string>::value)
 	{
-		root = point->child[1 - dir];
-		root->parent = nullptr;
-		point->child[1 - dir] = root->child[dir];
-		if (point->child[1 - dir] != nullptr)
-			point->child[1 - dir]->parent = point;
-		root->child[dir] = point;
-		point->parent = root;
+		value.assign(first, in);
+		return true;
 	}
 	else
 	{
-		std::shared_ptr<node> ancestor = point->parent;
-		dir_t side = which_child(point);
-		ancestor->child[side] = point->child[1 - dir];
-		ancestor->child[side]->parent = ancestor;
-		point->child[1 - dir] = ancestor->child[side]->child[dir];
-		if (point->child[1 - dir] != nullptr)
-			point->child[1 - dir]->parent = point;
-		ancestor->child[side]->child[dir] = point;
-		point->parent = ancestor->child[side];
+		std::istringstream field(std::string(first, in));
+		return bool(field >> value);
 	}
 }
 
-/** Returns the pointer to predecessor of the node indicated by 'point', i.e. that one that has the greatest key that is lesser than this node's key.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node> point - the pointer to the node whose predecessor should be found
-* @return a shared pointer of type std::shared_ptr<my_map<key_type, mapped_type>::node> to the predecessor
+/** Reads the pairs of the file 'name' in the text format of 'my_map::serialize', one pair per line. The file is mapped into memory, split
+* on line boundaries into chunks of at least TEXT_CHUNK_BYTES bytes, one per hardware thread at most, and the chunks are parsed in parallel
+* by 'parse_text_field'. As with operator>>, the reading stops at the first malformed pair; the pairs before it are kept.
+* @param const std::string& name - the name of the file
+* @param std::vector<std::pair<key_type, mapped_type>>& values - receives the pairs in the order of the file
+* @return true if the file has been opened, false otherwise
 */
-template<class key_type, class mapped_type>
-std::shared_ptr<typename my_map<key_type, mapped_type>::node> my_map<key_type, mapped_type>::predecessor(std::shared_ptr<node> point)
+template <class key_type, class mapped_type>
+bool read_text_pairs(const std::string& name, std::vector<std::pair<key_type, mapped_type>>& values)
 {
-	if (point->child[LEFT] != nullptr)
+	using value_type = std::pair<key_type, mapped_type>;
+	mapped_file file;
+	if (not file.open(name))
+		return false;
+	const char* text = file.data(), * end = text + file.size();
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunks = std::max<size_t>(1, std::min(threads, file.size() / TEXT_CHUNK_BYTES));
+	std::vector<const char*> borders{ text };
+	for (size_t i = 1; i < chunks; ++i)
 	{
-		point = point->child[LEFT];
-		while (point->child[RIGHT] != nullptr)
-			point = point->child[RIGHT];
-		return point;
+		const char* border = std::max(borders.back(), text + file.size() / chunks * i);
+		border = static_cast<const char*>(std::memchr(border, '\n', size_t(end - border)));
+		borders.push_back(border == nullptr ? end : border + 1);
 	}
-	else
+	borders.push_back(end);
+	struct chunk
 	{
-		while (true)
+		std::vector<value_type> values;
+		bool complete = false;
+	};
+	auto parse = [](const char* in, const char* last)
+	{
+		chunk part;
+		value_type value;
+		for (;;)
 		{
-			if (point->parent == nullptr)
-				throw my_exc(error_t::no_predecessor);
-			dir_t side = which_child(point);
-			point = point->parent;
-			if (side == RIGHT)
-				return point;
+			while (in != last and is_text_space(*in))
+				++in;
+			if (in == last)
+			{
+				part.complete = true;
+				return part;
+			}
+			if (not parse_text_field(in, last, value.first) or not parse_text_field(in, last, value.second))
+				return part;
+			part.values.push_back(std::move(value));
 		}
+	};
+	std::vector<std::future<chunk>> parts;
+	for (size_t i = 1; i < chunks; ++i)
+		parts.push_back(std::async(std::launch::async, parse, borders[i], borders[i + 1]));
+	chunk part = parse(borders[0], borders[1]);
+	values = std::move(part.values);
+	bool complete = part.complete;
+	for (std::future<chunk>& next : parts)
+	{
+		part = next.get();
+		if (complete)
+			values.insert(values.end(), std::make_move_iterator(part.values.begin()), std::make_move_iterator(part.values.end()));
+		complete = complete and part.complete;
 	}
+	return true;
 }
 
-/** Returns the pointer to successor of the node indicated by 'point', i.e. that one that has the least key that is greater than this node's key.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node> point - the pointer to the node whose successor should be found
-* @return a shared pointer of type std::shared_ptr<my_map<key_type, mapped_type>::node> to the successor
+/// Figures of the shape and of the memory of a my_map, gathered by 'my_map::inspect' for monitoring. Depths count the links from the root, which has depth 0.
+struct inspection_report
+{
+	size_t nodes = 0;
+	/// The numbers of red and black nodes, both 0 unless the balancing policy colours the nodes.
+	size_t red_nodes = 0, black_nodes = 0;
+	/// The number of nodes on the longest path from the root down, 0 for an empty map; at most twice 'black_height' in a red-black tree.
+	unsigned height = 0;
+	/// The number of black nodes on every path from the root down, 0 unless the balancing policy colours the nodes.
+	unsigned black_height = 0;
+	uint64_t total_depth = 0;
+	double average_depth = 0.0;
+	/// The number of nodes at every depth, of size 'height'.
+	std::vector<size_t> depth_histogram;
+	/// The bytes of the nodes, sizeof(node) each, of which 'payload_bytes' hold the pairs and 'link_bytes' the links, the balance, the summary and the padding.
+	/// Memory owned by the keys and the mapped values themselves, as by strings, is not included.
+	size_t node_bytes = 0, payload_bytes = 0, link_bytes = 0;
+	/// The bytes reserved by the node allocator, if it tells, as pool_allocator does; otherwise equal to 'node_bytes'. The excess over 'node_bytes' is free slots.
+	size_t allocator_bytes = 0;
+	/// The bytes of the lookup cache.
+	size_t cache_bytes = 0;
+	/// Whether the locality of the links has been measured.
+	bool locality = false;
+	/// The number of links from a node to its children, and how many of them lead to the same cache line or to the same 4 KiB page.
+	size_t child_links = 0, same_line_links = 0, same_page_links = 0;
+};
+
+/// Tells whether the allocator 'allocator_type' reports the memory it has reserved, by 'bytes_reserved', as pool_allocator does.
+template <class allocator_type, class = void>
+struct reports_reserved : std::false_type {};
+template <class allocator_type>
+struct reports_reserved<allocator_type, std::void_t<decltype(std::declval<const allocator_type&>().bytes_reserved())>> : std::true_type {};
+
+template <class key_type, class mapped_type, class compare>
+class my_map_view;
+
+/** Default statistics policy of my_map. All the hooks are empty inline functions, so the instrumentation compiles to nothing.
+* A policy is notified of every fix-up case of insertion and erasure, numbered from 1 to 6 by the balancing policy (I1 - I6 and D1 - D6 of a red-black tree),
+* of every rotation, of the number of recoloured nodes or other updated balances and of the length of every descent from the root.
 */
-template<class key_type, class mapped_type>
-std::shared_ptr<typename my_map<key_type, mapped_type>::node> my_map<key_type, mapped_type>::successor(std::shared_ptr<node> point)
+struct no_stats
 {
-	if (point->child[RIGHT] != nullptr)
+	void insert_case(unsigned) {}
+	void erase_case(unsigned) {}
+	void rotation() {}
+	void recolouring(unsigned) {}
+	void descent(unsigned) {}
+};
+
+/// Statistics policy of my_map counting the rebalancing work; read it with 'my_map::stats()'. Not synchronised.
+struct counting_stats
+{
+	size_t insert_cases[7] = {};
+	size_t erase_cases[7] = {};
+	size_t rotations = 0;
+	size_t recolourings = 0;
+	size_t descents = 0;
+	size_t total_descent_length = 0;
+	size_t max_descent_length = 0;
+
+	void insert_case(unsigned number) { ++insert_cases[number]; }
+	void erase_case(unsigned number) { ++erase_cases[number]; }
+	void rotation() { ++rotations; }
+	void recolouring(unsigned count) { recolourings += count; }
+	void descent(unsigned length)
 	{
-		point = point->child[RIGHT];
-		while (point->child[LEFT] != nullptr)
-			point = point->child[LEFT];
-		return point;
+		++descents;
+		total_descent_length += length;
+		if (length > max_descent_length)
+			max_descent_length = length;
 	}
-	else
+	/// Returns the average number of links followed by a descent from the root.
+	double average_descent_length() const { return descents == 0 ? 0.0 : double(total_descent_length) / descents; }
+	/// Zeroes all the counters.
+	void reset() { *this = counting_stats(); }
+};
+
+/** Default augmentation policy of my_map: the nodes keep no summary of their subtrees and nothing is maintained.
+* An augmentation policy defines 'summary_type' stored in every node, 'summarize' giving the summary of a single pair,
+* the associative 'combine' with its 'identity', 'enabled' and 'aggregate' extracting the 'aggregate_type' result of a summary;
+* the summary of every subtree is kept up to date through insertion, erasure and rotations.
+*/
+struct no_augmentation
+{
+	struct summary_type {};
+	using aggregate_type = summary_type;
+	static constexpr bool enabled = false;
+	template <class value_type>
+	static summary_type summarize(const value_type&) { return summary_type(); }
+	static summary_type combine(const summary_type&, const summary_type&) { return summary_type(); }
+	static summary_type identity() { return summary_type(); }
+	static aggregate_type aggregate(const summary_type& summary) { return summary; }
+};
+
+/// Augmentation policy of my_map keeping the number of nodes of every subtree. Enables 'rank' and 'select'; 'aggregate' counts the keys in a range.
+struct subtree_size
+{
+	using summary_type = size_t;
+	using aggregate_type = size_t;
+	static constexpr bool enabled = true;
+	template <class value_type>
+	static size_t summarize(const value_type&) { return 1; }
+	static size_t combine(size_t first, size_t second) { return first + second; }
+	static size_t identity() { return 0; }
+	static size_t aggregate(size_t summary) { return summary; }
+	static size_t size(size_t summary) { return summary; }
+};
+
+/** Augmentation policy of my_map keeping the subtree size and the aggregate of the pairs of every subtree under the monoid 'monoid'.
+* Enables 'rank', 'select' and 'aggregate' over a range of keys.
+* @param monoid - defines 'value_type', the associative 'combine' with its 'identity' and 'lift' giving the value of a single pair
+*/
+template <class monoid>
+struct sized_aggregate
+{
+	struct summary_type
 	{
-		while (true)
-		{
-			if (point->parent == nullptr)
-				throw my_exc(error_t::no_successor);
-			dir_t side = which_child(point);
-			point = point->parent;
-			if (side == LEFT)
-				return point;
-		}
+		size_t size;
+		typename monoid::value_type value;
+	};
+	using aggregate_type = typename monoid::value_type;
+	static constexpr bool enabled = true;
+	template <class value_type>
+	static summary_type summarize(const value_type& value) { return summary_type{ 1, monoid::lift(value) }; }
+	static summary_type combine(const summary_type& first, const summary_type& second)
+	{
+		return summary_type{ first.size + second.size, monoid::combine(first.value, second.value) };
 	}
-}
+	static summary_type identity() { return summary_type{ 0, monoid::identity() }; }
+	static aggregate_type aggregate(const summary_type& summary) { return summary.value; }
+	static size_t size(const summary_type& summary) { return summary.size; }
+};
 
-/// Internal class of my_map<key_type, mapped_type> used to store nodes' data
-template<class key_type, class mapped_type>
-my_map<key_type, mapped_type>::node::node()
+/// Monoid for sized_aggregate summing the mapped values, converted to 'sum_type'.
+template <class sum_type>
+struct mapped_sum
 {
-	data = std::make_pair(key_type(), mapped_type());
-	colour = RED;
-	parent = child[LEFT] = child[RIGHT] = nullptr;
-}
+	using value_type = sum_type;
+	static sum_type identity() { return sum_type(); }
+	static sum_type combine(const sum_type& first, const sum_type& second) { return first + second; }
+	template <class pair_type>
+	static sum_type lift(const pair_type& value) { return static_cast<sum_type>(value.second); }
+};
+
+/// Tells whether the comparator 'compare' is transparent, i.e. accepts keys of other types. 'other_key' only defers the check to the point of use.
+template <class compare, class other_key, class = void>
+struct transparent_compare : std::false_type {};
+template <class compare, class other_key>
+struct transparent_compare<compare, other_key, std::void_t<typename compare::is_transparent>> : std::true_type {};
+
+/// Tells whether std::hash is enabled for 'key_type', which the lookup cache of my_map requires.
+template <class key_type, class = void>
+struct hashable_key : std::false_type {};
+template <class key_type>
+struct hashable_key<key_type, std::void_t<decltype(std::hash<key_type>{}(std::declval<const key_type&>()))>> : std::true_type {};
+
+/// Tells whether the allocator 'allocator_type' can free all the objects it has allocated at once, by 'release', as pool_allocator does.
+template <class allocator_type, class = void>
+struct bulk_release : std::false_type {};
+template <class allocator_type>
+struct bulk_release<allocator_type, std::void_t<decltype(std::declval<allocator_type&>().release())>> : std::true_type {};
 
-/** Constructor of class my_map<key_type, mapped_type>::node. The colour is assigned to RED (0) and the children to nullptr.
-* @param std::pair<key_type, mapped_type> _data - the data to be stored in the node
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node> _parent - the pointer to the node's parent, nullptr by default
+/** Default balancing policy of my_map: a red-black tree. Every node is red or black, no red node has a red child and all the paths from a node down
+* pass the same number of black nodes, so the height is at most 2 log2(n + 1). An insertion rotates at most twice and an erasure at most three times.
+* The statistics policy is notified of the fix-up cases of insertion (I1 - I6) and erasure (D1 - D6), of the rotations and of the recoloured nodes.
+* A balancing policy defines the 'balance_type' kept in every node and its 'fresh' value for a new leaf, 'link' rebalancing after a leaf has been attached,
+* 'unlink' removing a node with at most one child, the 'rank' of a subtree with 'child_rank' and 'join' for splitting and joining trees,
+* 'parallel_rank', the least rank at which the set operations recurse in parallel, 'build' and 'make_root' for the trees built from sorted pairs,
+* and 'name' describing a balance for 'my_map::print'. The policy is a friend of my_map and rotates through it, so the statistics see every rotation.
 */
-template<class key_type, class mapped_type>
-my_map<key_type, mapped_type>::node::node(value_type _data, std::shared_ptr<node> _parent) : data(_data), parent(_parent)
+struct red_black_balance
 {
-	colour = RED;
-	child[LEFT] = nullptr;
-	child[RIGHT] = nullptr;
-}
+	using balance_type = colour_t;
+	/// Whether the balance is a colour, so that 'my_map::inspect' reports the red and black nodes and the black height.
+	static constexpr bool coloured = true;
+	static constexpr unsigned parallel_rank = PARALLEL_MIN_BLACK_HEIGHT;
+	static balance_type fresh() { return RED; }
+	template <class tree_type>
+	static void link(tree_type& tree, typename tree_type::node* point);
+	template <class tree_type>
+	static void unlink(tree_type& tree, typename tree_type::node* point);
+	template <class node_type>
+	static unsigned rank(const node_type* point);
+	template <class node_type>
+	static unsigned child_rank(const node_type* point, unsigned rank, dir_t side);
+	template <class tree_type>
+	static typename tree_type::subtree join(typename tree_type::subtree left, typename tree_type::node* pivot, typename tree_type::subtree right);
+	template <class node_type>
+	static void build(node_type* point, unsigned depth, unsigned lowest_depth);
+	template <class node_type>
+	static void make_root(node_type* point) { point->balance = BLACK; }
+	static std::string name(balance_type balance) { return balance == RED ? "red" : balance == BLACK ? "black" : "double_black"; }
+private:
+	template <class node_type>
+	static bool is_red(const node_type* point) { return point != nullptr and point->balance == RED; }
+	template <class tree_type>
+	static void resolve_double_black(tree_type& tree, typename tree_type::node* point);
+	template <class tree_type>
+	static typename tree_type::node* join_side(typename tree_type::node* big, unsigned big_height, typename tree_type::node* pivot,
+		typename tree_type::node* small, unsigned small_height, dir_t side);
+};
 
-/// Constructor of class my_map<key_type, mapped_type>. Assigns the root with nullptr.
-template<class key_type, class mapped_type>
-my_map<key_type, mapped_type>::my_map()
+/** Balancing policy of my_map keeping an AVL tree: the heights of the two subtrees of every node differ by at most one, so the height is at most
+* 1.44 log2(n + 2) and lookups follow fewer links than in a red-black tree, at the price of more rotations on updates. Every node keeps its height.
+* The statistics policy is notified, on insertion and erasure alike, of case 1 when retracing stops at a node whose height has not changed,
+* of case 2 for every node whose height has changed and above which retracing goes on, of case 3 for a single and of case 4 for a double rotation;
+* every changed height counts as a recoloured node.
+*/
+struct avl_balance
 {
-	root = nullptr;
-	number_of_nodes = 0;
-}
+	using balance_type = uint8_t;
+	static constexpr bool coloured = false;
+	/// An AVL tree of this height has at least 1596 nodes, about as many as a red-black tree of the black height PARALLEL_MIN_BLACK_HEIGHT.
+	static constexpr unsigned parallel_rank = PARALLEL_MIN_BLACK_HEIGHT + PARALLEL_MIN_BLACK_HEIGHT / 2;
+	static balance_type fresh() { return 1; }
+	template <class tree_type>
+	static void link(tree_type& tree, typename tree_type::node* point);
+	template <class tree_type>
+	static void unlink(tree_type& tree, typename tree_type::node* point);
+	template <class node_type>
+	static unsigned rank(const node_type* point) { return point == nullptr ? 0 : point->balance; }
+	template <class node_type>
+	static unsigned child_rank(const node_type* point, unsigned, dir_t side) { return rank(point->child[side]); }
+	template <class tree_type>
+	static typename tree_type::subtree join(typename tree_type::subtree left, typename tree_type::node* pivot, typename tree_type::subtree right);
+	template <class node_type>
+	static void build(node_type* point, unsigned, unsigned) { fix_height(point); }
+	template <class node_type>
+	static void make_root(node_type*) {}
+	static std::string name(balance_type balance) { return "height " + std::to_string(balance); }
+private:
+	template <class node_type>
+	static bool fix_height(node_type* point);
+	template <class tree_type>
+	static void retrace(tree_type& tree, typename tree_type::node* point, bool erasing);
+	template <class tree_type>
+	static typename tree_type::node* rotate(typename tree_type::node* point, dir_t dir);
+	template <class tree_type>
+	static typename tree_type::node* attach(typename tree_type::node* left, typename tree_type::node* pivot, typename tree_type::node* right);
+	template <class tree_type>
+	static typename tree_type::node* join_side(typename tree_type::node* big, typename tree_type::node* pivot, typename tree_type::node* small, dir_t side);
+};
 
-/** Move constructor of class my_map<key_type, mapped_type>. Takes over the contents of 'other'.
-* @param my_map<key_type, mapped_type>&& other - an rvalue map whose contents should be taken
+/** Balancing policy of my_map keeping a randomized treap: every node draws a random priority and no node has a greater priority than its parent,
+* so the tree is shaped like a binary search tree of the keys inserted in random order, whatever the order of the operations: the expected depth
+* of a node is about 1.39 log2 n. A new leaf is rotated up by its priority, about two rotations on average, a node with at most one child
+* is removed with no rotation at all and no balance information is ever updated, which makes the rebalancing cheap; lookups descend deeper.
+* The statistics policy is notified of insertion case 1 when the new leaf has found its place, of insertion case 2 for every rotation lifting it
+* and of erasure case 1 for every removed node.
 */
-template<class key_type, class mapped_type>
-my_map<key_type, mapped_type>::my_map(my_map&& other)
+struct treap_balance
 {
-	root = other.root;
-	other.root = nullptr;
-	number_of_nodes = other.number_of_nodes;
-}
+	using balance_type = uint32_t;
+	static constexpr bool coloured = false;
+	static constexpr unsigned parallel_rank = PARALLEL_MIN_BLACK_HEIGHT;
+	static balance_type fresh();
+	template <class tree_type>
+	static void link(tree_type& tree, typename tree_type::node* point);
+	template <class tree_type>
+	static void unlink(tree_type& tree, typename tree_type::node* point);
+	template <class node_type>
+	static unsigned rank(const node_type* point);
+	template <class node_type>
+	static unsigned child_rank(const node_type* point, unsigned, dir_t side) { return rank(point->child[side]); }
+	template <class tree_type>
+	static typename tree_type::subtree join(typename tree_type::subtree left, typename tree_type::node* pivot, typename tree_type::subtree right);
+	template <class node_type>
+	static void build(node_type* point, unsigned, unsigned);
+	template <class node_type>
+	static void make_root(node_type*) {}
+	static std::string name(balance_type balance) { return "priority " + std::to_string(balance); }
+private:
+	template <class tree_type>
+	static typename tree_type::node* join_nodes(typename tree_type::node* left, typename tree_type::node* pivot, typename tree_type::node* right);
+};
 
-/** Performs insertion into the map.
-* @param std::pair<key_type, mapped_type> value
+/** Rebalances the tree after the new red leaf indicated by 'point' has been attached below a node of the tree; the summaries are up to date.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the new leaf
 * @return void
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::insert(value_type value)
+template <class tree_type>
+void red_black_balance::link(tree_type& tree, typename tree_type::node* point)
 {
-	if (root == nullptr)
+	using node = typename tree_type::node;
+	if (point->parent->balance != RED)
 	{
-		root = std::shared_ptr<node>(new node(value));
-		root->colour = BLACK;
-		++number_of_nodes;
+		// Case I1
+		tree.statistics.insert_case(1);
 		return;
 	}
-	std::shared_ptr<node> point = root;
 	while (true)
 	{
-		if (value.first != point->data.first)
+		if (point->parent == nullptr)
 		{
-			dir_t side = (value.first < point->data.first ? LEFT : RIGHT);
-			if (point->child[side] == nullptr)
-			{
-				point->child[side] = std::shared_ptr<node>(new node(value, point));
-				point = point->child[side];
-				++number_of_nodes;
-				break;
-			}
-			else
-				point = point->child[side];
-		}
-		else
+			// Case I3
+			tree.statistics.insert_case(3);
+			tree.statistics.recolouring(1);
+			point->balance = BLACK;
 			return;
-	}
-	if (point->parent->colour == RED)
-	{
-		while (true)
+		}
+		if (point->parent->balance == RED)
 		{
-			if (point->parent == nullptr)
-			{
-				point->colour = BLACK;
-				return;
-			}
-			if (point->parent->colour == RED)
+			dir_t point_dir = tree_type::which_child(point),
+				parent_dir = tree_type::which_child(point->parent);
+			node* parent = point->parent,
+				* grandparent = parent->parent,
+				* uncle = grandparent->child[1 - parent_dir];
+			if (uncle == nullptr or uncle->balance == BLACK)
 			{
-				dir_t point_dir = which_child(point),
-					parent_dir = which_child(point->parent);
-				std::shared_ptr<node> parent = point->parent,
-					grandparent = parent->parent,
-					uncle = grandparent->child[1 - parent_dir];
-				if (uncle == nullptr or uncle->colour == BLACK)
+				if (point_dir != parent_dir)
 				{
-					if (point_dir != parent_dir)
-					{
-						rotation(parent, 1 - point_dir);
-						point.swap(parent);
-					}
-					rotation(grandparent, 1 - parent_dir);
-					parent->colour = BLACK;
-					grandparent->colour = RED;
-					return;
+					// Case I5
+					tree.statistics.insert_case(5);
+					tree.rotation(parent, 1 - point_dir);
+					std::swap(point, parent);
 				}
-				parent->colour = BLACK;
-				uncle->colour = BLACK;
-				grandparent->colour = RED;
-				point.swap(grandparent);
-			}
-			else
+				// Case I6
+				tree.statistics.insert_case(6);
+				tree.rotation(grandparent, 1 - parent_dir);
+				tree.statistics.recolouring(2);
+				parent->balance = BLACK;
+				grandparent->balance = RED;
 				return;
+			}
+			// Case I2
+			tree.statistics.insert_case(2);
+			tree.statistics.recolouring(3);
+			parent->balance = BLACK;
+			uncle->balance = BLACK;
+			grandparent->balance = RED;
+			point = grandparent;
+		}
+		else
+		{
+			// Case I1
+			tree.statistics.insert_case(1);
+			return;
 		}
 	}
 }
 
 /** Resolves the node marked as double black.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node>& point - shared pointer to the double black node
+* @param tree_type& tree - the map
+* @param tree_type::node* point - pointer to the double black node
 * @return void
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::resolve_double_black(std::shared_ptr<node>& point)
+template <class tree_type>
+void red_black_balance::resolve_double_black(tree_type& tree, typename tree_type::node* point)
 {
-	if (point == nullptr or point->colour != DOUBLE_BLACK)
+	using node = typename tree_type::node;
+	if (point == nullptr or point->balance != DOUBLE_BLACK)
 		return;
-	if (point == root)
+	if (point == tree.root)
 	{
 		// Case D1
-		std::cout << "Case D1" << std::endl;
-		root->colour = BLACK;
+		tree.statistics.erase_case(1);
+		tree.statistics.recolouring(1);
+		point->balance = BLACK;
 		return;
 	}
-	dir_t side = which_child(point);
-	std::shared_ptr<node> parent = point->parent, sibling = parent->child[1 - side],
-		close = sibling->child[side], distant = sibling->child[1 - side];
-	if (sibling != nullptr and sibling->colour == RED)
+	dir_t side = tree_type::which_child(point);
+	node* parent = point->parent, * sibling = parent->child[1 - side],
+		* close = sibling->child[side], * distant = sibling->child[1 - side];
+	if (sibling != nullptr and sibling->balance == RED)
 	{
 		// Case D3
-		std::cout << "Case D3" << std::endl;
-		rotation(parent, side);
-		parent->colour = RED;
-		sibling->colour = BLACK;
-		resolve_double_black(point);
+		tree.statistics.erase_case(3);
+		tree.statistics.recolouring(2);
+		tree.rotation(parent, side);
+		parent->balance = RED;
+		sibling->balance = BLACK;
+		resolve_double_black(tree, point);
 	}
 	else
 	{
-		if (distant != nullptr and distant->colour == RED)
+		if (distant != nullptr and distant->balance == RED)
 		{
 			// Case D6
-			std::cout << "Case D6" << std::endl;
-			rotation(parent, side);
-			sibling->colour = parent->colour;
-			parent->colour = BLACK;
-			distant->colour = BLACK;
-			point->colour = BLACK;
+			tree.statistics.erase_case(6);
+			tree.statistics.recolouring(4);
+			tree.rotation(parent, side);
+			sibling->balance = parent->balance;
+			parent->balance = BLACK;
+			distant->balance = BLACK;
+			point->balance = BLACK;
 		}
 		else
 		{
-			if (close != nullptr and close->colour == RED)
+			if (close != nullptr and close->balance == RED)
 			{
 				// Case D5
-				std::cout << "Case D5" << std::endl;
-				rotation(sibling, 1 - side);
-				sibling->colour = RED;
-				close->colour = BLACK;
-				resolve_double_black(point);
+				tree.statistics.erase_case(5);
+				tree.statistics.recolouring(2);
+				tree.rotation(sibling, 1 - side);
+				sibling->balance = RED;
+				close->balance = BLACK;
+				resolve_double_black(tree, point);
 			}
 			else
 			{
-				if (parent->colour == RED)
+				if (parent->balance == RED)
 				{
 					// Case D4
-					std::cout << "Case D4" << std::endl;
-					sibling->colour = RED;
-					parent->colour = BLACK;
-					point->colour = BLACK;
+					tree.statistics.erase_case(4);
+					tree.statistics.recolouring(3);
+					sibling->balance = RED;
+					parent->balance = BLACK;
+					point->balance = BLACK;
 				}
 				else
 				{
 					// Case D2
-					std::cout << "Case D2" << std::endl;
-					sibling->colour = RED;
-					point->colour = BLACK;
-					parent->colour = DOUBLE_BLACK;
-					resolve_double_black(parent);
+					tree.statistics.erase_case(2);
+					tree.statistics.recolouring(3);
+					sibling->balance = RED;
+					point->balance = BLACK;
+					parent->balance = DOUBLE_BLACK;
+					resolve_double_black(tree, parent);
 				}
 			}
 		}
 	}
 }
 
-/** Erases the node indicated by 'point'.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node>& point - shared pointer to the double black node
+/** Removes from the tree the node indicated by 'point', which is not the root and has at most one child, and rebalances the tree.
+* A removed black leaf is marked double black and resolved first, a black node is replaced by its child, which takes over its blackness.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the node to be removed
 * @return void
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::erase(std::shared_ptr<node>& point)
+template <class tree_type>
+void red_black_balance::unlink(tree_type& tree, typename tree_type::node* point)
 {
-	if (point->child[LEFT] == nullptr)
+	using node = typename tree_type::node;
+	node* child = point->child[point->child[LEFT] != nullptr ? LEFT : RIGHT];
+	if (child == nullptr)
 	{
-		if (point->child[RIGHT] == nullptr) // no children
-		{
-			if (point == root)
-			{
-				root.reset();
-				point.reset();
-			}
-			else
-			{
-				if (point->colour == BLACK)
-				{
-					point->colour = DOUBLE_BLACK;
-					resolve_double_black(point);
-				}
-				point->parent->child[which_child(point)] = nullptr;
-				point.reset();
-			}
-		}
-		else // right child only
+		if (point->balance == BLACK)
 		{
-			if (point == root)
-			{
-				root = point->child[RIGHT];
-				point->child[RIGHT]->parent = nullptr;
-				point.reset();
-			}
-			else
-			{
-				if (point->child[RIGHT]->colour == RED)
-				{
-					point->child[RIGHT]->colour = BLACK;
-					point->parent->child[which_child(point)] = point->child[RIGHT];
-					point->child[RIGHT]->parent = point->parent;
-					point.reset();
-				}
-				else
-				{
-					point->child[RIGHT]->colour = DOUBLE_BLACK;
-					point->parent->child[which_child(point)] = point->child[RIGHT];
-					point->child[RIGHT]->parent = point->parent;
-					resolve_double_black(point->child[RIGHT]);
-					point.reset();
-				}
-			}
+			point->balance = DOUBLE_BLACK;
+			resolve_double_black(tree, point);
 		}
+		point->parent->child[tree_type::which_child(point)] = nullptr;
+		tree_type::refresh_path(point->parent);
+		return;
 	}
-	else
+	bool red = (child->balance == RED);
+	child->balance = (red ? BLACK : DOUBLE_BLACK);
+	point->parent->child[tree_type::which_child(point)] = child;
+	child->parent = point->parent;
+	tree_type::refresh_path(point->parent);
+	if (not red)
+		resolve_double_black(tree, child);
+}
+
+/** Returns the black height of the subtree rooted in the node indicated by 'point', found along its leftmost path.
+* @param const node_type* point - the pointer to the root of the subtree or nullptr
+* @return the number of black nodes on every path from the root down
+*/
+template <class node_type>
+unsigned red_black_balance::rank(const node_type* point)
+{
+	unsigned height = 0;
+	for (; point != nullptr; point = point->child[LEFT])
+		if (point->balance == BLACK)
+			++height;
+	return height;
+}
+
+/** Returns the black height of a child of the root of a subtree.
+* @param const node_type* point - the pointer to the root of the subtree
+* @param unsigned rank - the black height of the subtree
+* @param int8_t side - the side of the child, which does not matter
+* @return the black height of the child's subtree
+*/
+template <class node_type>
+unsigned red_black_balance::child_rank(const node_type* point, unsigned rank, dir_t)
+{
+	return rank - (point->balance == BLACK ? 1 : 0);
+}
+
+/** Joins 'small' below the spine of 'big' on the side 'side', with 'pivot' between them: descends the spine of 'big' to the first black node
+* of the black height of 'small', puts there the red 'pivot' with that node and 'small' as its children and repairs red violations on the way back up.
+* @param tree_type::node* big - the root of the higher subtree
+* @param unsigned big_height - the black height of 'big'
+* @param tree_type::node* pivot - the node whose key lies between the keys of both subtrees
+* @param tree_type::node* small - the root of the lower subtree, black or empty
+* @param unsigned small_height - the black height of 'small', not greater than 'big_height'
+* @param int8_t side - RIGHT (1) if 'small' holds the greater keys, LEFT (0) otherwise
+* @return a pointer to the root of the joined subtree, of the black height of 'big'; the root may be red with a red child on the side 'side'
+*/
+template <class tree_type>
+typename tree_type::node* red_black_balance::join_side(typename tree_type::node* big, unsigned big_height, typename tree_type::node* pivot,
+	typename tree_type::node* small, unsigned small_height, dir_t side)
+{
+	using node = typename tree_type::node;
+	if (not is_red(big) and big_height == small_height)
 	{
-		if (point->child[RIGHT] == nullptr) // left child only
+		pivot->balance = RED;
+		pivot->child[1 - side] = big;
+		pivot->child[side] = small;
+		if (big != nullptr)
+			big->parent = pivot;
+		if (small != nullptr)
+			small->parent = pivot;
+		tree_type::update(pivot);
+		return pivot;
+	}
+	node* lower = join_side<tree_type>(big->child[side], big_height - (is_red(big) ? 0 : 1), pivot, small, small_height, side);
+	big->child[side] = lower;
+	lower->parent = big;
+	if (not is_red(big) and is_red(lower) and is_red(lower->child[side]))
+	{
+		lower->child[side]->balance = BLACK;
+		return tree_type::rotate(big, 1 - side);
+	}
+	tree_type::update(big);
+	return big;
+}
+
+/** Joins two detached subtrees with 'pivot' between them in O(|difference of their black heights| + 1). All the keys of 'left'
+* have to be less than the key of 'pivot' and all the keys of 'right' greater.
+* @param tree_type::subtree left - the subtree of the lesser keys
+* @param tree_type::node* pivot - the node of the middle key, detached
+* @param tree_type::subtree right - the subtree of the greater keys
+* @return the joined subtree, whose root may be red
+*/
+template <class tree_type>
+typename tree_type::subtree red_black_balance::join(typename tree_type::subtree left, typename tree_type::node* pivot, typename tree_type::subtree right)
+{
+	using node = typename tree_type::node;
+	using subtree = typename tree_type::subtree;
+	if (is_red(left.root))
+	{
+		left.root->balance = BLACK;
+		++left.rank;
+	}
+	if (is_red(right.root))
+	{
+		right.root->balance = BLACK;
+		++right.rank;
+	}
+	pivot->parent = nullptr;
+	if (left.rank != right.rank)
+	{
+		dir_t side = (left.rank > right.rank ? RIGHT : LEFT);
+		subtree big = (side == RIGHT ? left : right), small = (side == RIGHT ? right : left);
+		node* top = join_side<tree_type>(big.root, big.rank, pivot, small.root, small.rank, side);
+		top->parent = nullptr;
+		if (is_red(top) and is_red(top->child[side]))
+		{
+			top->balance = BLACK;
+			return subtree{ top, big.rank + 1 };
+		}
+		return subtree{ top, big.rank };
+	}
+	return subtree{ join_side<tree_type>(left.root, left.rank, pivot, right.root, right.rank, RIGHT), left.rank };
+}
+
+/** Colours a node of a tree built from sorted pairs: the nodes of the lowest level of the tree are red, the others black,
+* so that all the paths have the same number of black nodes.
+* @param node_type* point - the pointer to the node, whose children are already built
+* @param unsigned depth - the depth of the node
+* @param unsigned lowest_depth - the depth of the lowest level of the whole tree
+* @return void
+*/
+template <class node_type>
+void red_black_balance::build(node_type* point, unsigned depth, unsigned lowest_depth)
+{
+	point->balance = (depth == lowest_depth ? RED : BLACK);
+}
+
+/** Recomputes the height of the node indicated by 'point' from the heights of its children.
+* @param node_type* point - the pointer to the node
+* @return true if the height has changed, false otherwise
+*/
+template <class node_type>
+bool avl_balance::fix_height(node_type* point)
+{
+	balance_type height = balance_type(std::max(rank(point->child[LEFT]), rank(point->child[RIGHT])) + 1);
+	if (point->balance == height)
+		return false;
+	point->balance = height;
+	return true;
+}
+
+/** Walks up from the node indicated by 'point', recomputing the heights and rotating every node whose subtrees differ in height by two,
+* until a subtree has kept its height or the root is passed.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the lowest node whose subtree may have changed its height, or nullptr
+* @param bool erasing - whether a node has been removed, rather than inserted, so that the erasure cases are notified
+* @return void
+*/
+template <class tree_type>
+void avl_balance::retrace(tree_type& tree, typename tree_type::node* point, bool erasing)
+{
+	using node = typename tree_type::node;
+	auto notify = [&tree, erasing](unsigned number)
+	{
+		if (erasing)
+			tree.statistics.erase_case(number);
+		else
+			tree.statistics.insert_case(number);
+	};
+	unsigned changed = 0;
+	while (point != nullptr)
+	{
+		balance_type before = point->balance;
+		int factor = int(rank(point->child[RIGHT])) - int(rank(point->child[LEFT]));
+		if (factor > 1 or factor < -1)
+		{
+			dir_t side = (factor > 0 ? RIGHT : LEFT);
+			node* heavy = point->child[side];
+			int heavy_factor = int(rank(heavy->child[RIGHT])) - int(rank(heavy->child[LEFT]));
+			if (heavy_factor != 0 and (heavy_factor > 0) != (side == RIGHT))
+			{
+				// Case 4
+				notify(4);
+				tree.rotation(heavy, side);
+				changed += fix_height(heavy);
+				changed += fix_height(heavy->parent);
+			}
+			else
+			{
+				// Case 3
+				notify(3);
+			}
+			tree.rotation(point, 1 - side);
+			changed += fix_height(point);
+			point = point->parent;
+			changed += fix_height(point);
+		}
+		else
+			changed += fix_height(point);
+		if (point->balance == before)
+		{
+			// Case 1
+			notify(1);
+			break;
+		}
+		// Case 2
+		notify(2);
+		point = point->parent;
+	}
+	tree.statistics.recolouring(changed);
+}
+
+/** Rebalances the tree after the new leaf indicated by 'point' has been attached below a node of the tree; the summaries are up to date.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the new leaf
+* @return void
+*/
+template <class tree_type>
+void avl_balance::link(tree_type& tree, typename tree_type::node* point)
+{
+	retrace(tree, point->parent, false);
+}
+
+/** Removes from the tree the node indicated by 'point', which is not the root and has at most one child, and rebalances the tree.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the node to be removed
+* @return void
+*/
+template <class tree_type>
+void avl_balance::unlink(tree_type& tree, typename tree_type::node* point)
+{
+	using node = typename tree_type::node;
+	node* child = point->child[point->child[LEFT] != nullptr ? LEFT : RIGHT], * parent = point->parent;
+	parent->child[tree_type::which_child(point)] = child;
+	if (child != nullptr)
+		child->parent = parent;
+	tree_type::refresh_path(parent);
+	retrace(tree, parent, true);
+}
+
+/** Performs a rotation on the root of a detached subtree and recomputes the heights of both rotated nodes.
+* @param tree_type::node* point - the pointer to the root of the subtree
+* @param int8_t dir - the direction of rotation: LEFT (0) or RIGHT (1)
+* @return a pointer to the new root of the subtree
+*/
+template <class tree_type>
+typename tree_type::node* avl_balance::rotate(typename tree_type::node* point, dir_t dir)
+{
+	typename tree_type::node* top = tree_type::rotate(point, dir);
+	fix_height(point);
+	fix_height(top);
+	return top;
+}
+
+/** Makes 'left' and 'right' the children of 'pivot', whose heights differ by at most one.
+* @param tree_type::node* left - the root of the subtree of the lesser keys or nullptr
+* @param tree_type::node* pivot - the node of the middle key
+* @param tree_type::node* right - the root of the subtree of the greater keys or nullptr
+* @return 'pivot'
+*/
+template <class tree_type>
+typename tree_type::node* avl_balance::attach(typename tree_type::node* left, typename tree_type::node* pivot, typename tree_type::node* right)
+{
+	pivot->child[LEFT] = left;
+	pivot->child[RIGHT] = right;
+	if (left != nullptr)
+		left->parent = pivot;
+	if (right != nullptr)
+		right->parent = pivot;
+	fix_height(pivot);
+	tree_type::update(pivot);
+	return pivot;
+}
+
+/** Joins 'small' below the spine of 'big' on the side 'side', with 'pivot' between them: descends the spine of 'big' to the first node
+* at most one higher than 'small', puts there 'pivot' with that node and 'small' as its children and rotates on the way back up where needed.
+* @param tree_type::node* big - the root of the subtree at least two higher than 'small'
+* @param tree_type::node* pivot - the node whose key lies between the keys of both subtrees
+* @param tree_type::node* small - the root of the lower subtree or nullptr
+* @param int8_t side - RIGHT (1) if 'small' holds the greater keys, LEFT (0) otherwise
+* @return a pointer to the root of the joined subtree, of the height of 'big' or one more
+*/
+template <class tree_type>
+typename tree_type::node* avl_balance::join_side(typename tree_type::node* big, typename tree_type::node* pivot, typename tree_type::node* small, dir_t side)
+{
+	using node = typename tree_type::node;
+	node* inner = big->child[side], * lower;
+	bool placed = (rank(inner) <= rank(small) + 1);
+	if (placed)
+		lower = (side == RIGHT ? attach<tree_type>(inner, pivot, small) : attach<tree_type>(small, pivot, inner));
+	else
+		lower = join_side<tree_type>(inner, pivot, small, side);
+	big->child[side] = lower;
+	lower->parent = big;
+	if (rank(lower) <= rank(big->child[1 - side]) + 1)
+	{
+		fix_height(big);
+		tree_type::update(big);
+		return big;
+	}
+	if (placed)
+		big->child[side] = rotate<tree_type>(lower, side);
+	return rotate<tree_type>(big, 1 - side);
+}
+
+/** Joins two detached subtrees with 'pivot' between them in O(|difference of their heights| + 1). All the keys of 'left'
+* have to be less than the key of 'pivot' and all the keys of 'right' greater.
+* @param tree_type::subtree left - the subtree of the lesser keys
+* @param tree_type::node* pivot - the node of the middle key, detached
+* @param tree_type::subtree right - the subtree of the greater keys
+* @return the joined subtree
+*/
+template <class tree_type>
+typename tree_type::subtree avl_balance::join(typename tree_type::subtree left, typename tree_type::node* pivot, typename tree_type::subtree right)
+{
+	using node = typename tree_type::node;
+	node* top;
+	if (rank(left.root) > rank(right.root) + 1)
+		top = join_side<tree_type>(left.root, pivot, right.root, RIGHT);
+	else if (rank(right.root) > rank(left.root) + 1)
+		top = join_side<tree_type>(right.root, pivot, left.root, LEFT);
+	else
+		top = attach<tree_type>(left.root, pivot, right.root);
+	top->parent = nullptr;
+	return typename tree_type::subtree{ top, rank(top) };
+}
+
+/** Draws the priority of a new node from a generator of the calling thread, seeded once per thread.
+* @return the random priority
+*/
+inline treap_balance::balance_type treap_balance::fresh()
+{
+	thread_local uint64_t state = (uint64_t(std::random_device()()) << 32) ^ uint64_t(std::random_device()());
+	uint64_t mixed = (state += 0x9E3779B97F4A7C15);
+	mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9;
+	mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EB;
+	return balance_type((mixed ^ (mixed >> 31)) >> 32);
+}
+
+/** Lifts the new leaf indicated by 'point', attached below a node of the tree, by rotations while its priority is greater than its parent's.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the new leaf
+* @return void
+*/
+template <class tree_type>
+void treap_balance::link(tree_type& tree, typename tree_type::node* point)
+{
+	while (point->parent != nullptr and point->parent->balance < point->balance)
+	{
+		// Case 2
+		tree.statistics.insert_case(2);
+		tree.rotation(point->parent, 1 - tree_type::which_child(point));
+	}
+	// Case 1
+	tree.statistics.insert_case(1);
+}
+
+/** Removes from the tree the node indicated by 'point', which is not the root and has at most one child, by putting the child in its place.
+* The priorities stay ordered, since the child's is not greater than the parent's.
+* @param tree_type& tree - the map
+* @param tree_type::node* point - the pointer to the node to be removed
+* @return void
+*/
+template <class tree_type>
+void treap_balance::unlink(tree_type& tree, typename tree_type::node* point)
+{
+	using node = typename tree_type::node;
+	node* child = point->child[point->child[LEFT] != nullptr ? LEFT : RIGHT], * parent = point->parent;
+	parent->child[tree_type::which_child(point)] = child;
+	if (child != nullptr)
+		child->parent = parent;
+	tree_type::refresh_path(parent);
+	// Case 1
+	tree.statistics.erase_case(1);
+}
+
+/** Estimates the binary logarithm of the number of nodes of the subtree rooted in the node indicated by 'point': its priority is the greatest
+* of the priorities of the subtree, so the number of its leading one bits grows by one whenever the subtree doubles.
+* @param const node_type* point - the pointer to the root of the subtree or nullptr
+* @return the estimate, 0 for an empty subtree
+*/
+template <class node_type>
+unsigned treap_balance::rank(const node_type* point)
+{
+	if (point == nullptr)
+		return 0;
+	unsigned ones = 0;
+	for (balance_type priority = point->balance; ones < 32 and (priority & 0x80000000u) != 0; priority <<= 1)
+		++ones;
+	return ones + 1;
+}
+
+/** Joins two detached subtrees with 'pivot' between them: the root of the greatest priority stays on top and the rest are joined below it,
+* so the pivot sinks to the level of its priority, in expected O(log n). All the keys of 'left' have to be less than the key of 'pivot'
+* and all the keys of 'right' greater.
+* @param tree_type::node* left - the root of the subtree of the lesser keys or nullptr
+* @param tree_type::node* pivot - the node of the middle key
+* @param tree_type::node* right - the root of the subtree of the greater keys or nullptr
+* @return a pointer to the root of the joined subtree
+*/
+template <class tree_type>
+typename tree_type::node* treap_balance::join_nodes(typename tree_type::node* left, typename tree_type::node* pivot, typename tree_type::node* right)
+{
+	using node = typename tree_type::node;
+	if (left != nullptr and left->balance > pivot->balance and (right == nullptr or left->balance >= right->balance))
+	{
+		node* lower = join_nodes<tree_type>(left->child[RIGHT], pivot, right);
+		left->child[RIGHT] = lower;
+		lower->parent = left;
+		tree_type::update(left);
+		return left;
+	}
+	if (right != nullptr and right->balance > pivot->balance)
+	{
+		node* lower = join_nodes<tree_type>(left, pivot, right->child[LEFT]);
+		right->child[LEFT] = lower;
+		lower->parent = right;
+		tree_type::update(right);
+		return right;
+	}
+	pivot->child[LEFT] = left;
+	pivot->child[RIGHT] = right;
+	if (left != nullptr)
+		left->parent = pivot;
+	if (right != nullptr)
+		right->parent = pivot;
+	tree_type::update(pivot);
+	return pivot;
+}
+
+/** Joins two detached subtrees with 'pivot' between them, see 'join_nodes'.
+* @param tree_type::subtree left - the subtree of the lesser keys
+* @param tree_type::node* pivot - the node of the middle key, detached
+* @param tree_type::subtree right - the subtree of the greater keys
+* @return the joined subtree
+*/
+template <class tree_type>
+typename tree_type::subtree treap_balance::join(typename tree_type::subtree left, typename tree_type::node* pivot, typename tree_type::subtree right)
+{
+	typename tree_type::node* top = join_nodes<tree_type>(left.root, pivot, right.root);
+	top->parent = nullptr;
+	return typename tree_type::subtree{ top, rank(top) };
+}
+
+/** Orders the priorities of a node of a tree built from sorted pairs: its random priority sinks, swapping with the greater of the children's,
+* until no child has a greater one; the subtrees of the children are ordered already, so the whole tree takes O(n).
+* @param node_type* point - the pointer to the node, whose children are already built
+* @return void
+*/
+template <class node_type>
+void treap_balance::build(node_type* point, unsigned, unsigned)
+{
+	while (true)
+	{
+		node_type* greater = point->child[LEFT];
+		if (point->child[RIGHT] != nullptr and (greater == nullptr or point->child[RIGHT]->balance > greater->balance))
+			greater = point->child[RIGHT];
+		if (greater == nullptr or greater->balance <= point->balance)
+			return;
+		std::swap(point->balance, greater->balance);
+		point = greater;
+	}
+}
+
+/** Implementation of a map as a self-balancing binary search tree, a red-black tree by default.
+* @param key_type - the type used as the key
+* @mapped_type - the type of data assigned to the keys
+* @compare - the strict weak ordering of the keys, std::less<key_type> by default; a transparent one enables heterogeneous lookups
+* @allocator_type - the allocator the nodes are obtained from, rebound to the node type; a pool owned by the map by default
+* @stats_policy - the receiver of the rebalancing statistics, no_stats by default; counting_stats counts them
+* @augment_policy - the summary kept in every node for its subtree, no_augmentation by default; subtree_size and sized_aggregate enable order statistics
+* @balance_policy - the balancing scheme of the tree, red_black_balance by default; avl_balance keeps it shallower, treap_balance rebalances less
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>,
+	class allocator_type = pool_allocator<std::pair<key_type, mapped_type>>, class stats_policy = no_stats, class augment_policy = no_augmentation,
+	class balance_policy = red_black_balance>
+class my_map
+{
+	friend balance_policy;
+public:
+	using value_type = std::pair<key_type, mapped_type>;
+	using size_type = size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = value_type&;
+	using const_reference = const value_type&;
+private:
+	struct node
+	{
+		value_type data;
+		node* parent, * child[2];
+		typename balance_policy::balance_type balance;
+		typename augment_policy::summary_type summary;
+		node();
+		template <class... argument_types>
+		node(node* _parent, argument_types&&... arguments);
+	};
+	using node_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<node>;
+	using node_traits = std::allocator_traits<node_allocator_type>;
+	node_allocator_type node_allocator;
+	compare key_compare;
+	mutable stats_policy statistics;
+	node* root;
+	/// The nodes of the minimal and the maximal key, kept so that 'min', 'max', 'begin' and appending at either end take O(1).
+	node* leftmost, * rightmost;
+	size_t number_of_nodes;
+	/// The direct-mapped cache of the nodes found by 'at', indexed by the hash of the key; empty while disabled. A slot holds nullptr or a node of the tree.
+	mutable std::vector<node*> cache;
+	unsigned cache_bits = 0;
+	mutable size_t hit_count = 0, miss_count = 0;
+	template <class... argument_types>
+	node* create_node(node* parent, argument_types&&... arguments);
+	void destroy_node(node* point);
+	void destroy(node* point);
+	static inline dir_t which_child(node* point);
+	void rotation(node* point, dir_t dir);
+	static typename augment_policy::summary_type summary_of(const node* point);
+	static void update(node* point);
+	static void refresh_path(node* point);
+	static node* predecessor(node* point);
+	static node* successor(node* point);
+	node* first_node() const;
+	node* last_node() const;
+	void find_extremes();
+	template <class other_key>
+	node* find_node(const other_key& key) const;
+	template <class other_key>
+	node* lower_bound_node(const other_key& key) const;
+	template <class other_key>
+	node* upper_bound_node(const other_key& key) const;
+	void print_node(node* point, unsigned& level, unsigned& black_depth, dir_t& dir);
+	size_t cache_slot(const key_type& key) const;
+	node* find_cached(const key_type& key) const;
+	void forget(node* point);
+	void clear_cache();
+	template <class key_iterator, class function_type>
+	size_t find_nodes(key_iterator first, key_iterator last, function_type emit) const;
+	/// Enables the overloads of the lookups that take keys of other types, if the comparator is transparent.
+	template <class other_key>
+	using if_transparent = typename std::enable_if<transparent_compare<compare, other_key>::value>::type;
+
+
+public:
+	my_map();
+	explicit my_map(const allocator_type& allocator);
+	my_map(const my_map& other);
+	my_map(my_map&& other);
+	my_map& operator=(const my_map& other);
+	my_map& operator=(my_map&& other);
+	~my_map();
+	void clear();
+private:
+	node* descend(node* start, const key_type& key, dir_t& side) const;
+	node* link(node* point, node* parent, dir_t side);
+	node* insert(node* start, const value_type& value);
+	node* climb(node* finger, const key_type& key) const;
+	node* unlink(node* point);
+	void erase(node* point);
+public:
+	void erase(const key_type& key);
+	template <class iterator_type>
+	void insert_batch(iterator_type first, iterator_type last);
+	template <class iterator_type>
+	void erase_batch(iterator_type first, iterator_type last);
+private:
+	/// A detached subtree together with its rank given by the balancing policy, e.g. the black height of a red-black subtree.
+	struct subtree
+	{
+		node* root;
+		unsigned rank;
+	};
+	static subtree detach(subtree tree, dir_t side);
+	static size_t number_of_nodes_in(const node* point);
+	static node* rotate(node* point, dir_t dir);
+	static subtree join(subtree left, node* pivot, subtree right);
+	static subtree split_last(subtree tree, node*& last);
+	static subtree join(subtree left, subtree right);
+	std::pair<subtree, subtree> split(subtree tree, const key_type& key, node*& found) const;
+	subtree unite(subtree first, subtree second, std::vector<node*>& garbage, unsigned depth) const;
+	subtree intersect(subtree first, subtree second, std::vector<node*>& garbage, unsigned depth) const;
+	subtree subtract(subtree first, subtree second, std::vector<node*>& garbage, unsigned depth) const;
+	static unsigned parallel_depth();
+	node* clone(const node* source, node* parent);
+	subtree adopt(my_map& other);
+	void assign(subtree tree, std::vector<node*>& garbage, size_t total);
+public:
+	my_map split(const key_type& key);
+	void join(my_map&& greater);
+	void set_union(my_map&& other);
+	void set_intersection(my_map&& other);
+	void set_difference(my_map&& other);
+	value_type& max();
+	const value_type& max() const;
+	value_type& min();
+	const value_type& min() const;
+	template <bool constant>
+	class basic_iterator;
+	using iterator = basic_iterator<false>;
+	using const_iterator = basic_iterator<true>;
+	class node_handle;
+	struct insert_return_type;
+	std::pair<iterator, bool> insert(const value_type& value);
+	std::pair<iterator, bool> insert(value_type&& value);
+	iterator insert(const_iterator hint, const value_type& value);
+	iterator insert(const_iterator hint, value_type&& value);
+	template <class... argument_types>
+	std::pair<iterator, bool> emplace(argument_types&&... arguments);
+	template <class... argument_types>
+	iterator emplace_hint(const_iterator hint, argument_types&&... arguments);
+private:
+	template <class key_argument, class... argument_types>
+	std::pair<iterator, bool> emplace_key(key_argument&& key, argument_types&&... arguments);
+	template <class key_argument, class value_argument>
+	std::pair<iterator, bool> assign_key(key_argument&& key, value_argument&& value);
+	node* place_at(const_iterator hint, const key_type& key, dir_t& side) const;
+public:
+	template <class... argument_types>
+	std::pair<iterator, bool> try_emplace(const key_type& key, argument_types&&... arguments);
+	template <class... argument_types>
+	std::pair<iterator, bool> try_emplace(key_type&& key, argument_types&&... arguments);
+	template <class value_argument>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, value_argument&& value);
+	template <class value_argument>
+	std::pair<iterator, bool> insert_or_assign(key_type&& key, value_argument&& value);
+	mapped_type& operator[](const key_type& key);
+	mapped_type& operator[](key_type&& key);
+	node_handle extract(const key_type& key);
+	node_handle extract(const_iterator position);
+	insert_return_type insert(node_handle&& handle);
+	iterator begin();
+	const_iterator begin() const;
+	const_iterator cbegin() const;
+	iterator end();
+	const_iterator end() const;
+	const_iterator cend() const;
+	iterator find(const key_type& key);
+	const_iterator find(const key_type& key) const;
+	template <class other_key, class = if_transparent<other_key>>
+	iterator find(const other_key& key);
+	template <class other_key, class = if_transparent<other_key>>
+	const_iterator find(const other_key& key) const;
+	bool contains(const key_type& key) const;
+	template <class other_key, class = if_transparent<other_key>>
+	bool contains(const other_key& key) const;
+	size_t count(const key_type& key) const;
+	template <class other_key, class = if_transparent<other_key>>
+	size_t count(const other_key& key) const;
+	iterator lower_bound(const key_type& key);
+	const_iterator lower_bound(const key_type& key) const;
+	template <class other_key, class = if_transparent<other_key>>
+	iterator lower_bound(const other_key& key);
+	template <class other_key, class = if_transparent<other_key>>
+	const_iterator lower_bound(const other_key& key) const;
+	iterator upper_bound(const key_type& key);
+	const_iterator upper_bound(const key_type& key) const;
+	template <class other_key, class = if_transparent<other_key>>
+	iterator upper_bound(const other_key& key);
+	template <class other_key, class = if_transparent<other_key>>
+	const_iterator upper_bound(const other_key& key) const;
+	std::pair<iterator, iterator> equal_range(const key_type& key);
+	std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const;
+	template <class other_key, class = if_transparent<other_key>>
+	std::pair<iterator, iterator> equal_range(const other_key& key);
+	template <class other_key, class = if_transparent<other_key>>
+	std::pair<const_iterator, const_iterator> equal_range(const other_key& key) const;
+	mapped_type& at(const key_type& key);
+	const mapped_type& at(const key_type& key) const;
+	template <class key_iterator, class output_iterator>
+	size_t find_many(key_iterator first, key_iterator last, output_iterator out);
+	template <class key_iterator, class output_iterator>
+	size_t find_many(key_iterator first, key_iterator last, output_iterator out) const;
+	template <class other_key, class = if_transparent<other_key>>
+	mapped_type& at(const other_key& key);
+	template <class other_key, class = if_transparent<other_key>>
+	const mapped_type& at(const other_key& key) const;
+	void enable_cache(size_t slots);
+	size_t cache_hits() const;
+	size_t cache_misses() const;
+	template <class function_type>
+	void for_each_in_range(const key_type& low, const key_type& high, function_type function);
+	template <class function_type>
+	void for_each_in_range(const key_type& low, const key_type& high, function_type function) const;
+	size_t rank(const key_type& key) const;
+	iterator select(size_t index);
+	const_iterator select(size_t index) const;
+	typename augment_policy::aggregate_type aggregate(const key_type& low, const key_type& high) const;
+private:
+	void serialize(node* point, std::ofstream& file);
+	template <class iterator_type>
+	node* build(iterator_type& first, size_t count, unsigned depth, unsigned red_depth, node* parent);
+	template <class iterator_type>
+	node* build_tree(iterator_type first, size_t count);
+	void replace_tree(node* tree, size_t count);
+	void assign_sorted(std::vector<value_type>& values);
+public:
+	template <class iterator_type>
+	void build(iterator_type first, iterator_type last);
+	void serialize(const std::string& name);
+	std::future<serialize_report> serialize_async(const std::string& name) const;
+	void deserialize(const std::string& name);
+	void save_snapshot(const std::string& name, bool checksums = true);
+	void load_snapshot(const std::string& name);
+	template <class value_codec = raw_codec>
+	void save_compressed(const std::string& name);
+	template <class value_codec = raw_codec>
+	void load_compressed(const std::string& name);
+	bool empty() const;
+	size_t size() const;
+
+	void print();
+	inspection_report inspect(bool locality = false) const;
+	static constexpr size_t node_overhead();
+	const stats_policy& stats() const;
+	stats_policy& stats();
+
+	/** Bidirectional iterator over the pairs in the ascending order of keys. Stepping only follows the links of the nodes,
+	* it neither allocates nor throws; stepping past the maximal pair gives 'end()' and decrementing 'end()' gives the maximal pair.
+	* @param constant - true for const_iterator, false for iterator
+	*/
+	template <bool constant>
+	class basic_iterator
+	{
+		friend class my_map;
+		template <bool> friend class basic_iterator;
+		using map_pointer = typename std::conditional<constant, const my_map*, my_map*>::type;
+		node* my_node;
+		map_pointer owner;
+		basic_iterator(node* _my_node, map_pointer _owner) : my_node(_my_node), owner(_owner) {}
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type = typename my_map::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = typename std::conditional<constant, const value_type*, value_type*>::type;
+		using reference = typename std::conditional<constant, const value_type&, value_type&>::type;
+
+		basic_iterator() : my_node(nullptr), owner(nullptr) {}
+		/// Converts an iterator to a const_iterator.
+		template <bool other, class = typename std::enable_if<constant and not other>::type>
+		basic_iterator(const basic_iterator<other>& it) : my_node(it.my_node), owner(it.owner) {}
+		reference operator*() const { return my_node->data; }
+		pointer operator->() const { return &my_node->data; }
+		basic_iterator& operator++()
+		{
+			my_node = successor(my_node);
+			return *this;
+		}
+		basic_iterator operator++(int)
+		{
+			basic_iterator previous = *this;
+			my_node = successor(my_node);
+			return previous;
+		}
+		basic_iterator& operator--()
+		{
+			my_node = (my_node != nullptr ? predecessor(my_node) : owner->last_node());
+			return *this;
+		}
+		basic_iterator operator--(int)
+		{
+			basic_iterator previous = *this;
+			--*this;
+			return previous;
+		}
+		template <bool other>
+		bool operator==(const basic_iterator<other>& it) const { return my_node == it.my_node; }
+		template <bool other>
+		bool operator!=(const basic_iterator<other>& it) const { return my_node != it.my_node; }
+	};
+
+	/** Owner of a node taken out of the map by 'extract'. The node can be put into another map of the same type by 'insert'
+	* without allocating nor copying the pair if both maps share the node allocator, as maps constructed from copies of one pool_allocator do;
+	* an owned node is destroyed together with the handle. Move-only.
+	*/
+	class node_handle
+	{
+		friend class my_map;
+		node* my_node;
+		std::optional<node_allocator_type> allocator;
+		node_handle(node* _my_node, const node_allocator_type& _allocator) : my_node(_my_node), allocator(_allocator) {}
+		void reset()
+		{
+			if (my_node != nullptr)
+			{
+				node_traits::destroy(*allocator, my_node);
+				node_traits::deallocate(*allocator, my_node, 1);
+				my_node = nullptr;
+			}
+		}
+	public:
+		node_handle() : my_node(nullptr) {}
+		node_handle(node_handle&& other) : my_node(other.my_node), allocator(std::move(other.allocator)) { other.my_node = nullptr; }
+		node_handle& operator=(node_handle&& other)
+		{
+			if (this != &other)
+			{
+				reset();
+				my_node = other.my_node;
+				allocator = std::move(other.allocator);
+				other.my_node = nullptr;
+			}
+			return *this;
+		}
+		~node_handle() { reset(); }
+		bool empty() const { return my_node == nullptr; }
+		explicit operator bool() const { return my_node != nullptr; }
+		key_type& key() const { return my_node->data.first; }
+		mapped_type& mapped() const { return my_node->data.second; }
+	};
+
+	/// The result of inserting a node handle: the position of the key, whether the node was inserted and, if not, the handle still owning it.
+	struct insert_return_type
+	{
+		iterator position;
+		bool inserted;
+		node_handle node;
+	};
+};
+
+/** Checks the node indicated by 'point' whether it is its parent's right or left child.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node to be checked
+* @return constant value of type int8_t: LEFT (0) or RIGHT (1) denoting which child the node is
+* or ROOT (2) if the node has no parent
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+inline dir_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::which_child(node* point)
+{
+	return
+		point->parent != nullptr ? (point->parent->child[LEFT] == point ? LEFT : RIGHT) : ROOT;
+}
+
+/** Performs a rotation on the node pointed by 'point' in direction 'dir'.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node the rotation should be performed on
+* @param int8_t dir - the direction of rotation: LEFT (0) or RIGHT (1)
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::rotation(node* point, dir_t dir)
+{
+	if (point == nullptr)
+		throw my_exc(error_t::rotation_on_nullptr);
+	if (dir != LEFT and dir != RIGHT)
+		throw my_exc(error_t::wrong_direction);
+	if (point->child[1 - dir] == nullptr)
+	{
+		if (dir == LEFT)
+			throw my_exc(error_t::left_rotation_impossible);
+		else
+			throw my_exc(error_t::right_rotation_impossible);
+	}
+	statistics.rotation();
+	if (point == root)
+	{
+		root = point->child[1 - dir];
+		root->parent = nullptr;
+		point->child[1 - dir] = root->child[dir];
+		if (point->child[1 - dir] != nullptr)
+			point->child[1 - dir]->parent = point;
+		root->child[dir] = point;
+		point->parent = root;
+	}
+	else
+	{
+		node* ancestor = point->parent;
+		dir_t side = which_child(point);
+		ancestor->child[side] = point->child[1 - dir];
+		ancestor->child[side]->parent = ancestor;
+		point->child[1 - dir] = ancestor->child[side]->child[dir];
+		if (point->child[1 - dir] != nullptr)
+			point->child[1 - dir]->parent = point;
+		ancestor->child[side]->child[dir] = point;
+		point->parent = ancestor->child[side];
+	}
+	update(point);
+	update(point->parent);
+}
+
+/** Returns the summary of the subtree rooted in the node indicated by 'point', the identity for an empty subtree.
+* @param const my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the root of the subtree or nullptr
+* @return the summary of the subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename augment_policy::summary_type my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::summary_of(const node* point)
+{
+	return point != nullptr ? point->summary : augment_policy::identity();
+}
+
+/** Recomputes the summary of the node indicated by 'point' from the summaries of its children. Does nothing without augmentation.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::update(node* point)
+{
+	if constexpr (augment_policy::enabled)
+		point->summary = augment_policy::combine(augment_policy::combine(summary_of(point->child[LEFT]), augment_policy::summarize(point->data)),
+			summary_of(point->child[RIGHT]));
+}
+
+/** Recomputes the summaries of the node indicated by 'point' and of all its ancestors, after its subtree has changed.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the lowest changed node or nullptr
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::refresh_path(node* point)
+{
+	if constexpr (augment_policy::enabled)
+		for (; point != nullptr; point = point->parent)
+			update(point);
+}
+
+/** Returns the pointer to predecessor of the node indicated by 'point', i.e. that one that has the greatest key that is lesser than this node's key.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node whose predecessor should be found
+* @return a pointer of type my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* to the predecessor, or nullptr if the node holds the minimal key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::predecessor(node* point)
+{
+	if (point->child[LEFT] != nullptr)
+	{
+		point = point->child[LEFT];
+		while (point->child[RIGHT] != nullptr)
+			point = point->child[RIGHT];
+		return point;
+	}
+	else
+	{
+		while (true)
+		{
+			if (point->parent == nullptr)
+				return nullptr;
+			dir_t side = which_child(point);
+			point = point->parent;
+			if (side == RIGHT)
+				return point;
+		}
+	}
+}
+
+/** Returns the pointer to successor of the node indicated by 'point', i.e. that one that has the least key that is greater than this node's key.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node whose successor should be found
+* @return a pointer of type my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* to the successor, or nullptr if the node holds the maximal key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::successor(node* point)
+{
+	if (point->child[RIGHT] != nullptr)
+	{
+		point = point->child[RIGHT];
+		while (point->child[LEFT] != nullptr)
+			point = point->child[LEFT];
+		return point;
+	}
+	else
+	{
+		while (true)
+		{
+			if (point->parent == nullptr)
+				return nullptr;
+			dir_t side = which_child(point);
+			point = point->parent;
+			if (side == LEFT)
+				return point;
+		}
+	}
+}
+
+/// Internal class of my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy> used to store nodes' data
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node::node()
+{
+	data = std::make_pair(key_type(), mapped_type());
+	balance = balance_policy::fresh();
+	parent = child[LEFT] = child[RIGHT] = nullptr;
+	summary = augment_policy::summarize(data);
+}
+
+/** Constructor of class my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node. The balance is that of a new leaf, e.g. RED (0), and the children are assigned to nullptr.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* _parent - the pointer to the node's parent
+* @param argument_types&&... arguments - the arguments the data stored in the node is constructed from in place
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class... argument_types>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node::node(node* _parent, argument_types&&... arguments) : data(std::forward<argument_types>(arguments)...), parent(_parent)
+{
+	balance = balance_policy::fresh();
+	child[LEFT] = nullptr;
+	child[RIGHT] = nullptr;
+	summary = augment_policy::summarize(data);
+}
+
+/** Obtains a slot from the node allocator and constructs a new leaf in it.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* parent - the pointer to the node's parent
+* @param argument_types&&... arguments - the arguments the data stored in the node is constructed from in place
+* @return a pointer to the new node
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class... argument_types>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::create_node(node* parent, argument_types&&... arguments)
+{
+	node* point = node_traits::allocate(node_allocator, 1);
+	try
+	{
+		node_traits::construct(node_allocator, point, parent, std::forward<argument_types>(arguments)...);
+	}
+	catch (...)
+	{
+		node_traits::deallocate(node_allocator, point, 1);
+		throw;
+	}
+	return point;
+}
+
+/** Destroys the node indicated by 'point' and returns its slot to the node allocator. The links are not updated.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node to be destroyed
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::destroy_node(node* point)
+{
+	forget(point);
+	node_traits::destroy(node_allocator, point);
+	node_traits::deallocate(node_allocator, point, 1);
+}
+
+/** Destroys the whole subtree rooted in the node indicated by 'point' in O(n) with no recursion nor extra memory, whatever its shape:
+* a node with a left child is rotated right, so the tree turns into a chain of right children that is destroyed from the top.
+* The links of the subtree are used as scratch; the parent links are ignored, so detached subtrees may be passed.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the root of the subtree
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::destroy(node* point)
+{
+	while (point != nullptr)
+	{
+		if (node* left = point->child[LEFT]; left != nullptr)
+		{
+			point->child[LEFT] = left->child[RIGHT];
+			left->child[RIGHT] = point;
+			point = left;
+		}
+		else
+		{
+			node* next = point->child[RIGHT];
+			destroy_node(point);
+			point = next;
+		}
+	}
+}
+
+/// Constructor of class my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>. Assigns the root with nullptr.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::my_map()
+{
+	root = leftmost = rightmost = nullptr;
+	number_of_nodes = 0;
+}
+
+/** Constructor of class my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy> taking the allocator the nodes should be obtained from.
+* Maps constructed from copies of one pool_allocator share its node pool, so that 'join', the set operations and node handles pass nodes between them
+* with no allocation nor copy of the pairs.
+* @param const allocator_type& allocator - the allocator, rebound to the node type
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::my_map(const allocator_type& allocator) : node_allocator(allocator)
+{
+	root = leftmost = rightmost = nullptr;
+	number_of_nodes = 0;
+}
+
+/** Copy constructor of class my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>. Copies the tree of 'other' in O(n)
+* node by node, keeping its shape and balance, with no comparisons nor rebalancing. The allocator is obtained by select_on_container_copy_construction,
+* which gives pool_allocator a pool of its own. The lookup cache, if enabled in 'other', is enabled empty with the same number of slots.
+* @param const my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& other - the map to be copied
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::my_map(const my_map& other) : node_allocator(node_traits::select_on_container_copy_construction(other.node_allocator)), key_compare(other.key_compare)
+{
+	root = clone(other.root, nullptr);
+	find_extremes();
+	number_of_nodes = other.number_of_nodes;
+	cache.assign(other.cache.size(), nullptr);
+	cache_bits = other.cache_bits;
+}
+
+/** Move constructor of class my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>. Takes over the contents of 'other' together with its allocator;
+* 'other' gets a new allocator, so that it does not keep sharing a pool with this map.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>&& other - an rvalue map whose contents should be taken
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::my_map(my_map&& other) : node_allocator(std::move(other.node_allocator)), key_compare(std::move(other.key_compare))
+{
+	if constexpr (std::is_default_constructible<node_allocator_type>::value)
+		other.node_allocator = node_allocator_type();
+	root = other.root;
+	leftmost = other.leftmost;
+	rightmost = other.rightmost;
+	other.root = other.leftmost = other.rightmost = nullptr;
+	number_of_nodes = other.number_of_nodes;
+	other.number_of_nodes = 0;
+	cache.swap(other.cache);
+	std::swap(cache_bits, other.cache_bits);
+	std::swap(hit_count, other.hit_count);
+	std::swap(miss_count, other.miss_count);
+}
+
+/// Destructor of class my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>. Destroys all the nodes, see 'clear'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::~my_map()
+{
+	clear();
+}
+
+/** Copy assignment. Copies the tree of 'other' as the copy constructor does, into nodes of this map's allocator, and then destroys the previous contents,
+* so this map is left unchanged if the copy throws.
+* @param const my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& other - the map to be copied
+* @return a reference to this map
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::operator=(const my_map& other)
+{
+	if (this == &other)
+		return *this;
+	node* copy = clone(other.root, nullptr);
+	clear_cache();
+	destroy(root);
+	root = copy;
+	find_extremes();
+	number_of_nodes = other.number_of_nodes;
+	key_compare = other.key_compare;
+	return *this;
+}
+
+/** Move assignment. Destroys the contents of this map with 'clear' and takes over those of 'other', together with its allocator if the allocator propagates;
+* otherwise the pairs are copied, unless both allocators compare equal. 'other' is left empty, with a new allocator if its own was taken. Replacing a large map this way takes no longer than 'clear'.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>&& other - an rvalue map whose contents should be taken
+* @return a reference to this map
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::operator=(my_map&& other)
+{
+	if (this == &other)
+		return *this;
+	clear();
+	key_compare = std::move(other.key_compare);
+	number_of_nodes = other.number_of_nodes;
+	if (node_traits::propagate_on_container_move_assignment::value or node_allocator == other.node_allocator)
+	{
+		root = other.root;
+		leftmost = other.leftmost;
+		rightmost = other.rightmost;
+		other.root = other.leftmost = other.rightmost = nullptr;
+	}
+	else
+	{
+		root = clone(other.root, nullptr);
+		find_extremes();
+		other.clear();
+	}
+	if constexpr (node_traits::propagate_on_container_move_assignment::value)
+	{
+		node_allocator = std::move(other.node_allocator);
+		if constexpr (std::is_default_constructible<node_allocator_type>::value)
+			other.node_allocator = node_allocator_type();
+	}
+	other.number_of_nodes = 0;
+	other.clear_cache();
+	return *this;
+}
+
+/** Erases all the pairs. If the allocator can free its objects in bulk, as pool_allocator does when this map is the only user of its pool,
+* and the pairs need no destruction, the slabs are freed at once, in time proportional to their number; otherwise the nodes are destroyed
+* one by one, in O(n) with no recursion, see 'destroy'. The lookup cache stays enabled.
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::clear()
+{
+	clear_cache();
+	bool released = false;
+	if constexpr (bulk_release<node_allocator_type>::value and std::is_trivially_destructible<node>::value)
+		released = (root != nullptr and node_allocator.release());
+	if (not released)
+		destroy(root);
+	root = leftmost = rightmost = nullptr;
+	number_of_nodes = 0;
+}
+
+/** Looks for the place of the key 'key' descending from the node 'start', which has to be the root or a node whose subtree spans the position of the key.
+* Starting from the root, a key beyond either end of the map is placed next to the finger of that end with no descent.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* start - the pointer to the node the descent starts from
+* @param const key_type& key - the key
+* @param int8_t& side - receives ROOT (2) if the key is present, otherwise the side of the returned node where the key belongs
+* @return a pointer to the node holding the key if it is present, otherwise to the parent-to-be of its node; nullptr if the map is empty
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::descend(node* start, const key_type& key, dir_t& side) const
+{
+	side = LEFT;
+	if (start == root and root != nullptr)
+	{
+		if (key_compare(rightmost->data.first, key))
+		{
+			side = RIGHT;
+			statistics.descent(0);
+			return rightmost;
+		}
+		if (key_compare(key, leftmost->data.first))
+		{
+			statistics.descent(0);
+			return leftmost;
+		}
+	}
+	node* point = start;
+	unsigned depth = 0;
+	while (point != nullptr)
+	{
+		if (key_compare(key, point->data.first))
+			side = LEFT;
+		else if (key_compare(point->data.first, key))
+			side = RIGHT;
+		else
+		{
+			side = ROOT;
+			return point;
+		}
+		++depth;
+		if (point->child[side] == nullptr)
+			break;
+		point = point->child[side];
+	}
+	statistics.descent(depth);
+	return point;
+}
+
+/** Inserts into the tree the new node indicated by 'point' as the child 'side' of 'parent', found by 'descend', then rebalances the tree.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the detached node to be inserted
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* parent - the pointer to the parent-to-be or nullptr if the map is empty
+* @param int8_t side - LEFT (0) or RIGHT (1)
+* @return 'point'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::link(node* point, node* parent, dir_t side)
+{
+	point->parent = parent;
+	point->child[LEFT] = point->child[RIGHT] = nullptr;
+	point->balance = balance_policy::fresh();
+	point->summary = augment_policy::summarize(point->data);
+	++number_of_nodes;
+	if (parent == nullptr)
+	{
+		root = leftmost = rightmost = point;
+		balance_policy::make_root(root);
+		return point;
+	}
+	parent->child[side] = point;
+	if (parent == leftmost and side == LEFT)
+		leftmost = point;
+	else if (parent == rightmost and side == RIGHT)
+		rightmost = point;
+	refresh_path(point->parent);
+	balance_policy::link(*this, point);
+	return point;
+}
+
+/** Inserts 'value' descending from the node 'start' instead of the root, then rebalances the tree. 'start' has to be the root
+* or a node whose subtree spans the position of the key, e.g. one found by 'climb'.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* start - the pointer to the node the descent starts from
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return a pointer to the node holding the key, the new one or the one already present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert(node* start, const value_type& value)
+{
+	dir_t side;
+	node* parent = descend(start, value.first, side);
+	if (side == ROOT)
+		return parent;
+	return link(create_node(parent, value), parent, side);
+}
+
+/** Performs insertion into the map; a key already present keeps its value.
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the key was present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert(const value_type& value)
+{
+	return emplace_key(value.first, value.second);
+}
+
+/** Performs insertion into the map, moving the pair into the new node; a key already present keeps its value and 'value' is left intact.
+* @param std::pair<key_type, mapped_type>&& value - the pair to be inserted
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the key was present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert(value_type&& value)
+{
+	return emplace_key(std::move(value.first), std::move(value.second));
+}
+
+/** Finds the place of the key 'key' next to 'hint': the key belongs right before the pair indicated by 'hint', or right after it.
+* Then the new node is attached to the hint or to its neighbour with no descent; otherwise the place is found by a descent from the root.
+* Appending a sorted sequence with 'end()' as the hint, or with the position of the previous insertion, takes amortised O(1) per pair.
+* @param const_iterator hint - the iterator to the pair the key should be inserted next to
+* @param const key_type& key - the key
+* @param int8_t& side - receives the same as from 'descend'
+* @return the same as 'descend'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::place_at(const_iterator hint, const key_type& key, dir_t& side) const
+{
+	node* point = hint.my_node;
+	if (point == nullptr or key_compare(key, point->data.first))
+	{
+		node* before = (point == nullptr ? rightmost : predecessor(point));
+		if (before == nullptr or key_compare(before->data.first, key))
+		{
+			statistics.descent(0);
+			if (point != nullptr and point->child[LEFT] == nullptr)
+			{
+				side = LEFT;
+				return point;
+			}
+			side = (before == nullptr ? LEFT : RIGHT);
+			return before;
+		}
+	}
+	else if (key_compare(point->data.first, key))
+	{
+		node* after = successor(point);
+		if (after == nullptr or key_compare(key, after->data.first))
+		{
+			statistics.descent(0);
+			if (point->child[RIGHT] == nullptr)
+			{
+				side = RIGHT;
+				return point;
+			}
+			side = LEFT;
+			return after;
+		}
+	}
+	else
+	{
+		side = ROOT;
+		return point;
+	}
+	return descend(root, key, side);
+}
+
+/** Performs insertion into the map next to 'hint', in amortised O(1) if the key belongs right before or right after the pair indicated by 'hint'.
+* A key already present keeps its value.
+* @param const_iterator hint - the iterator to the pair the key should be inserted next to, 'end()' to append
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return the iterator to the pair of the key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert(const_iterator hint, const value_type& value)
+{
+	return emplace_hint(hint, value);
+}
+
+/** Performs insertion into the map next to 'hint', moving the pair into the new node, like 'insert(hint, const value_type&)'.
+* @param const_iterator hint - the iterator to the pair the key should be inserted next to, 'end()' to append
+* @param std::pair<key_type, mapped_type>&& value - the pair to be inserted
+* @return the iterator to the pair of the key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert(const_iterator hint, value_type&& value)
+{
+	dir_t side;
+	node* parent = place_at(hint, value.first, side);
+	if (side == ROOT)
+		return iterator(parent, this);
+	return iterator(link(create_node(parent, std::move(value)), parent, side), this);
+}
+
+/** Constructs a pair in place from 'arguments' and inserts it unless its key is present, in which case the pair is destroyed.
+* The pair has to be constructed before its key can be looked for; 'try_emplace' avoids that.
+* @param argument_types&&... arguments - the arguments of a constructor of std::pair<key_type, mapped_type>
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the key was present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class... argument_types>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::emplace(argument_types&&... arguments)
+{
+	node* point = create_node(nullptr, std::forward<argument_types>(arguments)...);
+	dir_t side;
+	node* parent;
+	try
+	{
+		parent = descend(root, point->data.first, side);
+	}
+	catch (...)
+	{
+		destroy_node(point);
+		throw;
+	}
+	if (side == ROOT)
+	{
+		destroy_node(point);
+		return std::make_pair(iterator(parent, this), false);
+	}
+	return std::make_pair(iterator(link(point, parent, side), this), true);
+}
+
+/** Constructs a pair in place from 'arguments' and inserts it next to 'hint', like 'insert(hint, value)', unless its key is present.
+* @param const_iterator hint - the iterator to the pair the key should be inserted next to, 'end()' to append
+* @param argument_types&&... arguments - the arguments of a constructor of std::pair<key_type, mapped_type>
+* @return the iterator to the pair of the key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class... argument_types>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::emplace_hint(const_iterator hint, argument_types&&... arguments)
+{
+	node* point = create_node(nullptr, std::forward<argument_types>(arguments)...);
+	dir_t side;
+	node* parent;
+	try
+	{
+		parent = place_at(hint, point->data.first, side);
+	}
+	catch (...)
+	{
+		destroy_node(point);
+		throw;
+	}
+	if (side == ROOT)
+	{
+		destroy_node(point);
+		return iterator(parent, this);
+	}
+	return iterator(link(point, parent, side), this);
+}
+
+
+/** Inserts the pair of the key 'key' and the mapped value constructed in place from 'arguments', unless the key is present.
+* @param key_argument&& key - the key, copied or moved into the new node
+* @param argument_types&&... arguments - the arguments of a constructor of mapped_type
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the key was present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class key_argument, class... argument_types>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::emplace_key(key_argument&& key, argument_types&&... arguments)
+{
+	dir_t side;
+	node* parent = descend(root, key, side);
+	if (side == ROOT)
+		return std::make_pair(iterator(parent, this), false);
+	node* point = create_node(parent, std::piecewise_construct, std::forward_as_tuple(std::forward<key_argument>(key)),
+		std::forward_as_tuple(std::forward<argument_types>(arguments)...));
+	return std::make_pair(iterator(link(point, parent, side), this), true);
+}
+
+/** Assigns 'value' to the key 'key' if it is present, otherwise inserts the pair of both.
+* @param key_argument&& key - the key, copied or moved into a new node
+* @param value_argument&& value - the value, assigned or moved into the pair
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the value was assigned
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class key_argument, class value_argument>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::assign_key(key_argument&& key, value_argument&& value)
+{
+	dir_t side;
+	node* parent = descend(root, key, side);
+	if (side == ROOT)
+	{
+		parent->data.second = std::forward<value_argument>(value);
+		refresh_path(parent);
+		return std::make_pair(iterator(parent, this), false);
+	}
+	node* point = create_node(parent, std::forward<key_argument>(key), std::forward<value_argument>(value));
+	return std::make_pair(iterator(link(point, parent, side), this), true);
+}
+
+/** Inserts the pair of the key 'key' and the mapped value constructed in place from 'arguments'. Nothing is constructed if the key is present.
+* @param const key_type& key - the key
+* @param argument_types&&... arguments - the arguments of a constructor of mapped_type
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the key was present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class... argument_types>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::try_emplace(const key_type& key, argument_types&&... arguments)
+{
+	return emplace_key(key, std::forward<argument_types>(arguments)...);
+}
+
+/** Inserts the pair of the key 'key', moved into the new node, and the mapped value constructed in place from 'arguments'.
+* Nothing is constructed nor moved if the key is present.
+* @param key_type&& key - the key
+* @param argument_types&&... arguments - the arguments of a constructor of mapped_type
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the key was present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class... argument_types>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::try_emplace(key_type&& key, argument_types&&... arguments)
+{
+	return emplace_key(std::move(key), std::forward<argument_types>(arguments)...);
+}
+
+/** Assigns 'value' to the key 'key' if it is present, otherwise inserts the pair of both.
+* @param const key_type& key - the key
+* @param value_argument&& value - the value, assignable and convertible to mapped_type
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the value was assigned
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class value_argument>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert_or_assign(const key_type& key, value_argument&& value)
+{
+	return assign_key(key, std::forward<value_argument>(value));
+}
+
+/** Assigns 'value' to the key 'key' if it is present, otherwise inserts the pair of both, moving the key into the new node.
+* @param key_type&& key - the key
+* @param value_argument&& value - the value, assignable and convertible to mapped_type
+* @return the iterator to the pair of the key and true if the pair was inserted, false if the value was assigned
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class value_argument>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, bool> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert_or_assign(key_type&& key, value_argument&& value)
+{
+	return assign_key(std::move(key), std::forward<value_argument>(value));
+}
+
+/** Returns the value mapped to the key 'key', inserting a value-initialised one first if the key is not present.
+* Note that the summaries of the augmentation are not refreshed when the value is modified through the reference.
+* @param const key_type& key - the key
+* @return the reference to the mapped value
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+mapped_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::operator[](const key_type& key)
+{
+	return emplace_key(key).first->second;
+}
+
+/** Returns the value mapped to the key 'key', inserting a value-initialised one first, with the key moved into the node, if the key is not present.
+* @param key_type&& key - the key
+* @return the reference to the mapped value
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+mapped_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::operator[](key_type&& key)
+{
+	return emplace_key(std::move(key)).first->second;
+}
+
+/** Takes the pair of the key 'key' out of the map together with its node, with no copy nor deallocation.
+* @param const key_type& key - the key
+* @return the handle owning the node, empty if the key is not present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node_handle my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::extract(const key_type& key)
+{
+	node* point = find_node(key);
+	if (point == nullptr)
+		return node_handle();
+	--number_of_nodes;
+	return node_handle(unlink(point), node_allocator);
+}
+
+/** Takes the pair indicated by 'position' out of the map together with its node.
+* @param const_iterator position - the iterator to the pair, not 'end()'
+* @return the handle owning the node
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node_handle my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::extract(const_iterator position)
+{
+	--number_of_nodes;
+	return node_handle(unlink(position.my_node), node_allocator);
+}
+
+/** Inserts the node owned by 'handle' unless its key is present. The node is linked as it is if the handle comes from a map sharing the allocator,
+* e.g. one constructed from a copy of the allocator this map was constructed from; otherwise the pair is moved into a node of this map's allocator.
+* @param node_handle&& handle - the handle obtained from 'extract', emptied if the node is inserted
+* @return the position of the key, whether the node was inserted and, if it was not, the handle still owning it
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert_return_type my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert(node_handle&& handle)
+{
+	if (handle.empty())
+		return insert_return_type{ end(), false, node_handle() };
+	dir_t side;
+	node* parent = descend(root, handle.key(), side);
+	if (side == ROOT)
+		return insert_return_type{ iterator(parent, this), false, std::move(handle) };
+	node* point;
+	if (*handle.allocator == node_allocator)
+	{
+		point = handle.my_node;
+		handle.my_node = nullptr;
+	}
+	else
+	{
+		point = create_node(parent, std::move(handle.my_node->data));
+		handle.reset();
+	}
+	return insert_return_type{ iterator(link(point, parent, side), this), true, node_handle() };
+}
+
+/** Unlinks the node indicated by 'point' from the tree and rebalances it. A node with two children first trades places and balance data
+* with the node of its predecessor, so no pair moves between nodes and only the iterators to 'point' are invalidated. The number of nodes is not updated.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - pointer to the node to be unlinked
+* @return 'point'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::unlink(node* point)
+{
+	forget(point);
+	if (point == leftmost)
+		leftmost = successor(point);
+	if (point == rightmost)
+		rightmost = predecessor(point);
+	if (point->child[LEFT] != nullptr and point->child[RIGHT] != nullptr)
+	{
+		node* replacer = predecessor(point);
+		node* parent = point->parent;
+		dir_t side = which_child(point);
+		node* below = replacer->child[LEFT];
+		if (replacer == point->child[LEFT])
+		{
+			point->parent = replacer;
+			replacer->child[LEFT] = point;
+		}
+		else
+		{
+			point->parent = replacer->parent;
+			point->parent->child[RIGHT] = point;
+			replacer->child[LEFT] = point->child[LEFT];
+			replacer->child[LEFT]->parent = replacer;
+		}
+		replacer->child[RIGHT] = point->child[RIGHT];
+		replacer->child[RIGHT]->parent = replacer;
+		point->child[LEFT] = below;
+		point->child[RIGHT] = nullptr;
+		if (below != nullptr)
+			below->parent = point;
+		replacer->parent = parent;
+		if (parent == nullptr)
+			root = replacer;
+		else
+			parent->child[side] = replacer;
+		std::swap(point->balance, replacer->balance);
+		refresh_path(point);
+	}
+	if (point == root)
+	{
+		root = point->child[point->child[LEFT] != nullptr ? LEFT : RIGHT];
+		if (root != nullptr)
+		{
+			root->parent = nullptr;
+			balance_policy::make_root(root);
+		}
+		return point;
+	}
+	balance_policy::unlink(*this, point);
+	return point;
+}
+
+/** Erases the node indicated by 'point'.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - pointer to the node to be erased
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::erase(node* point)
+{
+	destroy_node(unlink(point));
+}
+
+/** Erases the node that holds 'key' as key if such is present in the tree.
+* @param const key_type& key - the key of the node to be erased
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::erase(const key_type& key)
+{
+	node* point = find_node(key);
+	if (point == nullptr)
+		return;
+	erase(point);
+	--number_of_nodes;
+}
+
+/** Returns the lowest node on the path from 'finger' to the root whose subtree spans the position of 'key', which is not less than the key of 'finger'.
+* A descent started there instead of at the root costs O(log d), where d is the distance in keys between 'finger' and 'key'.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* finger - the pointer to a node of the tree
+* @param const key_type& key - the key not less than the key of 'finger'
+* @return a pointer to the node the descent should start from
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::climb(node* finger, const key_type& key) const
+{
+	node* point = finger;
+	while (true)
+	{
+		node* bound = point;
+		while (bound->parent != nullptr and which_child(bound) == RIGHT)
+			bound = bound->parent;
+		bound = bound->parent;
+		if (bound == nullptr or key_compare(key, bound->data.first))
+			return point;
+		point = bound;
+	}
+}
+
+/** Inserts the pairs of the range [first, last), as 'insert' would one by one: of repeated keys the first one is kept
+* and the present pairs keep their values. The batch is sorted first. A batch of at least a quarter of the size of the map is merged
+* with the contents of the map in one in-order pass and the tree is rebuilt in O(n + k); a smaller one is inserted in the ascending order,
+* each descent starting from the previously inserted node rather than from the root, which costs O(k log(n / k)) descents.
+* @param iterator_type first - the input iterator to the first pair
+* @param iterator_type last - the iterator past the last pair
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class iterator_type>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::insert_batch(iterator_type first, iterator_type last)
+{
+	std::vector<value_type> values(first, last);
+	if (values.empty())
+		return;
+	if (values.size() * BATCH_REBUILD_RATIO >= number_of_nodes)
+	{
+		assign_sorted(values);
+		return;
+	}
+	std::stable_sort(values.begin(), values.end(), [this](const value_type& a, const value_type& b) { return key_compare(a.first, b.first); });
+	node* finger = insert(root, values.front());
+	for (size_t i = 1; i < values.size(); ++i)
+		finger = insert(climb(finger, values[i].first), values[i]);
+}
+
+/** Erases the pairs of the keys of the range [first, last) that are present in the map. The keys are sorted first.
+* A batch of at least a quarter of the size of the map is removed in one in-order pass, the remaining pairs are copied and rebuilt into a tree in O(n + k),
+* which replaces the old one only once it is complete, so the map is left unchanged if anything throws;
+* a smaller one is erased in the ascending order, each search starting from the successor of the previously erased node.
+* @param iterator_type first - the input iterator to the first key
+* @param iterator_type last - the iterator past the last key
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class iterator_type>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::erase_batch(iterator_type first, iterator_type last)
+{
+	std::vector<key_type> keys(first, last);
+	if (keys.empty() or root == nullptr)
+		return;
+	std::sort(keys.begin(), keys.end(), key_compare);
+	if (keys.size() * BATCH_REBUILD_RATIO >= number_of_nodes)
+	{
+		std::vector<value_type> kept;
+		kept.reserve(number_of_nodes);
+		auto key = keys.begin();
+		for (node* point = first_node(); point != nullptr; point = successor(point))
+		{
+			while (key != keys.end() and key_compare(*key, point->data.first))
+				++key;
+			if (key == keys.end() or key_compare(point->data.first, *key))
+				kept.push_back(point->data);
+		}
+		replace_tree(kept.empty() ? nullptr : build_tree(std::make_move_iterator(kept.begin()), kept.size()), kept.size());
+		return;
+	}
+	node* finger = nullptr;
+	for (const key_type& key : keys)
+	{
+		node* point = (finger == nullptr ? root : climb(finger, key));
+		while (point != nullptr)
+		{
+			if (key_compare(key, point->data.first))
+			{
+				finger = point;
+				point = point->child[LEFT];
+			}
+			else if (key_compare(point->data.first, key))
+				point = point->child[RIGHT];
+			else
+				break;
+		}
+		if (point == nullptr)
+			continue;
+		finger = successor(point);
+		erase(point);
+		--number_of_nodes;
+		if (finger == nullptr)
+			return;
+	}
+}
+
+/** Returns the number of nodes of the subtree rooted in the node indicated by 'point'.
+* @param const my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the root of the subtree or nullptr
+* @return the number of nodes
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::number_of_nodes_in(const node* point)
+{
+	return point == nullptr ? 0 : number_of_nodes_in(point->child[LEFT]) + 1 + number_of_nodes_in(point->child[RIGHT]);
+}
+
+/** Detaches the child 'side' of the root of 'tree' and returns it as a separate subtree.
+* @param subtree tree - the subtree whose root loses its child
+* @param int8_t side - LEFT (0) or RIGHT (1)
+* @return the detached subtree with its rank
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::detach(subtree tree, dir_t side)
+{
+	node* child = tree.root->child[side];
+	unsigned rank = balance_policy::child_rank(tree.root, tree.rank, side);
+	tree.root->child[side] = nullptr;
+	if (child != nullptr)
+		child->parent = nullptr;
+	return subtree{ child, rank };
+}
+
+/** Performs a rotation on the root of a detached subtree, like 'rotation' but without touching the root of the map nor the statistics,
+* so that it can run on several subtrees at once. The parent of the subtree is not updated.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the root of the subtree
+* @param int8_t dir - the direction of rotation: LEFT (0) or RIGHT (1)
+* @return a pointer to the new root of the subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::rotate(node* point, dir_t dir)
+{
+	node* top = point->child[1 - dir];
+	point->child[1 - dir] = top->child[dir];
+	if (top->child[dir] != nullptr)
+		top->child[dir]->parent = point;
+	top->child[dir] = point;
+	top->parent = point->parent;
+	point->parent = top;
+	update(point);
+	update(top);
+	return top;
+}
+
+/** Joins two detached subtrees with 'pivot' between them as the balancing policy does, in O(log n) - for a red-black tree
+* in O(|difference of their black heights| + 1). All the keys of 'left' have to be less than the key of 'pivot' and all the keys of 'right' greater.
+* @param subtree left - the subtree of the lesser keys
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* pivot - the node of the middle key, detached
+* @param subtree right - the subtree of the greater keys
+* @return the joined subtree, whose root may be red in a red-black tree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::join(subtree left, node* pivot, subtree right)
+{
+	return balance_policy::template join<my_map>(left, pivot, right);
+}
+
+/** Removes the node of the greatest key from a detached subtree.
+* @param subtree tree - the non-empty subtree
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*& last - receives the removed node, detached
+* @return the remaining subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::split_last(subtree tree, node*& last)
+{
+	node* point = tree.root;
+	subtree left = detach(tree, LEFT), right = detach(tree, RIGHT);
+	if (right.root == nullptr)
+	{
+		last = point;
+		return left;
+	}
+	return join(left, point, split_last(right, last));
+}
+
+/** Joins two detached subtrees, all the keys of 'left' being less than all the keys of 'right', in O(log n).
+* @param subtree left - the subtree of the lesser keys
+* @param subtree right - the subtree of the greater keys
+* @return the joined subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::join(subtree left, subtree right)
+{
+	if (left.root == nullptr)
+		return right;
+	if (right.root == nullptr)
+		return left;
+	node* last = nullptr;
+	subtree rest = split_last(left, last);
+	return join(rest, last, right);
+}
+
+/** Splits a detached subtree by the key 'key' in O(log n): the subtrees hanging off the search path are joined back on both sides.
+* @param subtree tree - the subtree to be split
+* @param const key_type& key - the key
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*& found - receives the detached node of the key 'key', if present; left unchanged otherwise
+* @return the subtrees of the keys less and greater than 'key'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree, typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::split(subtree tree, const key_type& key, node*& found) const
+{
+	if (tree.root == nullptr)
+		return std::make_pair(tree, tree);
+	node* point = tree.root;
+	subtree left = detach(tree, LEFT), right = detach(tree, RIGHT);
+	if (key_compare(key, point->data.first))
+	{
+		std::pair<subtree, subtree> parts = split(left, key, found);
+		return std::make_pair(parts.first, join(parts.second, point, right));
+	}
+	if (key_compare(point->data.first, key))
+	{
+		std::pair<subtree, subtree> parts = split(right, key, found);
+		return std::make_pair(join(left, point, parts.first), parts.second);
+	}
+	found = point;
+	return std::make_pair(left, right);
+}
+
+/** Returns the depth of recursion up to which the set operations run both halves in parallel: enough levels to give every core some work.
+* @return the depth
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+unsigned my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::parallel_depth()
+{
+	static const unsigned depth = []()
+	{
+		unsigned threads = std::thread::hardware_concurrency(), levels = 0;
+		while ((1u << levels) < threads)
+			++levels;
+		return levels + 1;
+	}();
+	return depth;
+}
+
+/** Joins the union of two detached subtrees, the pairs of 'first' taking precedence: 'second' is split by the root of 'first' and
+* the halves are united recursively, in parallel near the top. O(m log(n / m + 1)) work for subtrees of m <= n nodes.
+* @param subtree first - the subtree whose pairs take precedence
+* @param subtree second - the other subtree
+* @param std::vector<my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*>& garbage - receives the detached nodes to be destroyed afterwards
+* @param unsigned depth - the depth of recursion
+* @return the united subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::unite(subtree first, subtree second, std::vector<node*>& garbage, unsigned depth) const
+{
+	if (first.root == nullptr)
+		return second;
+	if (second.root == nullptr)
+		return first;
+	node* point = first.root, * found = nullptr;
+	subtree first_left = detach(first, LEFT), first_right = detach(first, RIGHT);
+	std::pair<subtree, subtree> parts = split(second, point->data.first, found);
+	if (found != nullptr)
+		garbage.push_back(found);
+	subtree left, right;
+	if (depth < parallel_depth() and std::max(first.rank, second.rank) >= balance_policy::parallel_rank)
+	{
+		std::vector<node*> left_garbage;
+		std::future<subtree> task = std::async(std::launch::async, [&]() { return unite(first_left, parts.first, left_garbage, depth + 1); });
+		right = unite(first_right, parts.second, garbage, depth + 1);
+		left = task.get();
+		garbage.insert(garbage.end(), left_garbage.begin(), left_garbage.end());
+	}
+	else
+	{
+		left = unite(first_left, parts.first, garbage, depth + 1);
+		right = unite(first_right, parts.second, garbage, depth + 1);
+	}
+	return join(left, point, right);
+}
+
+/** Joins the intersection of two detached subtrees, the pairs of 'first' being kept, like 'unite'.
+* @param subtree first - the subtree whose pairs are kept
+* @param subtree second - the other subtree
+* @param std::vector<my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*>& garbage - receives the detached nodes and subtrees to be destroyed afterwards
+* @param unsigned depth - the depth of recursion
+* @return the intersection
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::intersect(subtree first, subtree second, std::vector<node*>& garbage, unsigned depth) const
+{
+	if (first.root == nullptr or second.root == nullptr)
+	{
+		if (first.root != nullptr)
+			garbage.push_back(first.root);
+		if (second.root != nullptr)
+			garbage.push_back(second.root);
+		return subtree{ nullptr, 0 };
+	}
+	node* point = first.root, * found = nullptr;
+	subtree first_left = detach(first, LEFT), first_right = detach(first, RIGHT);
+	std::pair<subtree, subtree> parts = split(second, point->data.first, found);
+	subtree left, right;
+	if (depth < parallel_depth() and std::max(first.rank, second.rank) >= balance_policy::parallel_rank)
+	{
+		std::vector<node*> left_garbage;
+		std::future<subtree> task = std::async(std::launch::async, [&]() { return intersect(first_left, parts.first, left_garbage, depth + 1); });
+		right = intersect(first_right, parts.second, garbage, depth + 1);
+		left = task.get();
+		garbage.insert(garbage.end(), left_garbage.begin(), left_garbage.end());
+	}
+	else
+	{
+		left = intersect(first_left, parts.first, garbage, depth + 1);
+		right = intersect(first_right, parts.second, garbage, depth + 1);
+	}
+	if (found != nullptr)
+	{
+		garbage.push_back(found);
+		return join(left, point, right);
+	}
+	garbage.push_back(point);
+	return join(left, right);
+}
+
+/** Joins the pairs of 'first' whose keys are not in 'second': 'first' is split by the root of 'second' and the halves are subtracted recursively, like 'unite'.
+* @param subtree first - the subtree the keys are subtracted from
+* @param subtree second - the subtree of the keys to be subtracted
+* @param std::vector<my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*>& garbage - receives the detached nodes and subtrees to be destroyed afterwards
+* @param unsigned depth - the depth of recursion
+* @return the difference
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtract(subtree first, subtree second, std::vector<node*>& garbage, unsigned depth) const
+{
+	if (first.root == nullptr or second.root == nullptr)
+	{
+		if (second.root != nullptr)
+			garbage.push_back(second.root);
+		return first;
+	}
+	node* point = second.root, * found = nullptr;
+	subtree second_left = detach(second, LEFT), second_right = detach(second, RIGHT);
+	std::pair<subtree, subtree> parts = split(first, point->data.first, found);
+	garbage.push_back(point);
+	if (found != nullptr)
+		garbage.push_back(found);
+	subtree left, right;
+	if (depth < parallel_depth() and std::max(first.rank, second.rank) >= balance_policy::parallel_rank)
+	{
+		std::vector<node*> left_garbage;
+		std::future<subtree> task = std::async(std::launch::async, [&]() { return subtract(parts.first, second_left, left_garbage, depth + 1); });
+		right = subtract(parts.second, second_right, garbage, depth + 1);
+		left = task.get();
+		garbage.insert(garbage.end(), left_garbage.begin(), left_garbage.end());
+	}
+	else
+	{
+		left = subtract(parts.first, second_left, garbage, depth + 1);
+		right = subtract(parts.second, second_right, garbage, depth + 1);
+	}
+	return join(left, right);
+}
+
+/** Copies the subtree rooted in the node indicated by 'source' into nodes obtained from the allocator of this map, keeping its shape and balance.
+* @param const my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* source - the pointer to the root of the subtree or nullptr
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* parent - the pointer to the parent of the copy
+* @return a pointer to the root of the copy
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::clone(const node* source, node* parent)
+{
+	if (source == nullptr)
+		return nullptr;
+	node* point = create_node(parent, source->data);
+	point->balance = source->balance;
+	point->summary = source->summary;
+	try
+	{
+		point->child[LEFT] = clone(source->child[LEFT], point);
+		point->child[RIGHT] = clone(source->child[RIGHT], point);
+	}
+	catch (...)
+	{
+		destroy(point);
+		throw;
+	}
+	return point;
+}
+
+/** Takes all the nodes of 'other', leaving it empty. The nodes are taken over as they are if both maps share the allocator,
+* otherwise they are copied into nodes of this map's allocator first and the originals are destroyed.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>& other - the map to be emptied
+* @return the tree of 'other' as a detached subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::subtree my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::adopt(my_map& other)
+{
+	subtree tree{ other.root, balance_policy::rank(other.root) };
+	other.clear_cache();
+	if (not (node_allocator == other.node_allocator))
+	{
+		tree.root = clone(other.root, nullptr);
+		other.destroy(other.root);
+	}
+	other.root = other.leftmost = other.rightmost = nullptr;
+	other.number_of_nodes = 0;
+	return tree;
+}
+
+/** Makes 'tree' the tree of this map and destroys the nodes and subtrees collected in 'garbage'.
+* @param subtree tree - the new tree
+* @param std::vector<my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*>& garbage - the detached nodes and subtrees
+* @param size_t total - the number of nodes of 'tree' and 'garbage' together
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::assign(subtree tree, std::vector<node*>& garbage, size_t total)
+{
+	clear_cache();
+	root = tree.root;
+	if (root != nullptr)
+	{
+		root->parent = nullptr;
+		balance_policy::make_root(root);
+	}
+	find_extremes();
+	for (node* point : garbage)
+	{
+		total -= number_of_nodes_in(point);
+		destroy(point);
+	}
+	garbage.clear();
+	number_of_nodes = total;
+}
+
+/** Moves the pairs of keys not less than 'key' into a new map, which shares the allocator of this one, in O(log n);
+* counting the sizes of both parts takes O(min(m, n - m)) more.
+* @param const key_type& key - the key dividing the map
+* @return the map of the greater keys
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::split(const key_type& key)
+{
+	my_map greater;
+	greater.node_allocator = node_allocator;
+	node* found = nullptr;
+	std::pair<subtree, subtree> parts = split(subtree{ root, balance_policy::rank(root) }, key, found);
+	if (found != nullptr)
+		parts.second = join(subtree{ nullptr, 0 }, found, parts.second);
+	size_t total = number_of_nodes;
+	std::vector<node*> none;
+	assign(parts.first, none, 0);
+	greater.assign(parts.second, none, 0);
+	node* mine = first_node(), * theirs = greater.first_node();
+	size_t steps = 0;
+	for (; mine != nullptr and theirs != nullptr; ++steps)
+	{
+		mine = successor(mine);
+		theirs = successor(theirs);
+	}
+	number_of_nodes = (mine == nullptr ? steps : total - steps);
+	greater.number_of_nodes = total - number_of_nodes;
+	return greater;
+}
+
+/** Appends the pairs of 'greater', whose keys have to be all greater than the keys of this map, in O(log n). 'greater' is left empty.
+* Throws if the ranges of keys overlap.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>&& greater - the map of the greater keys
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::join(my_map&& greater)
+{
+	if (greater.root == nullptr)
+		return;
+	if (root != nullptr and not key_compare(last_node()->data.first, greater.first_node()->data.first))
+		throw my_exc(error_t::overlapping_ranges);
+	size_t total = number_of_nodes + greater.number_of_nodes;
+	subtree right = adopt(greater);
+	std::vector<node*> none;
+	if (root == nullptr)
+	{
+		assign(right, none, total);
+		return;
+	}
+	node* pivot = nullptr;
+	subtree left = split_last(subtree{ root, balance_policy::rank(root) }, pivot);
+	assign(join(left, pivot, right), none, total);
+}
+
+/** Makes this map the union of itself and 'other', in O(m log(n / m + 1)) work for sizes m <= n, the recursion running in parallel on all cores.
+* The pairs of this map take precedence; 'other' is left empty. The statistics policy is not notified of the rotations.
+* Nodes are moved rather than copied if both maps share the allocator.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>&& other - the other map
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::set_union(my_map&& other)
+{
+	size_t total = number_of_nodes + other.number_of_nodes;
+	subtree second = adopt(other);
+	std::vector<node*> garbage;
+	assign(unite(subtree{ root, balance_policy::rank(root) }, second, garbage, 0), garbage, total);
+}
+
+/** Keeps only the pairs whose keys are also present in 'other', like 'set_union'; 'other' is left empty.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>&& other - the other map
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::set_intersection(my_map&& other)
+{
+	size_t total = number_of_nodes + other.number_of_nodes;
+	subtree second = adopt(other);
+	std::vector<node*> garbage;
+	assign(intersect(subtree{ root, balance_policy::rank(root) }, second, garbage, 0), garbage, total);
+}
+
+/** Erases the pairs whose keys are present in 'other', like 'set_union'; 'other' is left empty.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>&& other - the other map
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::set_difference(my_map&& other)
+{
+	size_t total = number_of_nodes + other.number_of_nodes;
+	subtree second = adopt(other);
+	std::vector<node*> garbage;
+	assign(subtract(subtree{ root, balance_policy::rank(root) }, second, garbage, 0), garbage, total);
+}
+
+/** Returns the pair of the maximal key and its mapped value. Throws if the map is empty.
+* @return the reference to the pair of type std::pair<key_type, mapped_type> of the maximal key and its mapped value
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::value_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::max()
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	return last_node()->data;
+}
+
+/** Returns the pair of the maximal key and its mapped value. Throws if the map is empty.
+* @return the reference to the pair of type std::pair<key_type, mapped_type> of the maximal key and its mapped value
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+const typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::value_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::max() const
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	return last_node()->data;
+}
+
+/** Returns the pair of the minimal key and its mapped value. Throws if the map is empty.
+* @return the reference to the pair of type std::pair<key_type, mapped_type> of the minimal key and its mapped value
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::value_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::min()
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	return first_node()->data;
+}
+
+/** Returns the pair of the minimal key and its mapped value. Throws if the map is empty.
+* @return the reference to the pair of type std::pair<key_type, mapped_type> of the minimal key and its mapped value
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+const typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::value_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::min() const
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	return first_node()->data;
+}
+
+/** Returns the pointer to the node holding the minimal key.
+* @return the pointer, or nullptr if the map is empty
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::first_node() const
+{
+	return leftmost;
+}
+
+/** Returns the pointer to the node holding the maximal key.
+* @return the pointer, or nullptr if the map is empty
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::last_node() const
+{
+	return rightmost;
+}
+
+/** Finds the nodes of the minimal and the maximal key walking down the spines of the tree, after it has been replaced as a whole.
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find_extremes()
+{
+	leftmost = rightmost = root;
+	if (root != nullptr)
+	{
+		while (leftmost->child[LEFT] != nullptr)
+			leftmost = leftmost->child[LEFT];
+		while (rightmost->child[RIGHT] != nullptr)
+			rightmost = rightmost->child[RIGHT];
+	}
+}
+
+/** Returns the iterator to the pair of the minimal key.
+* @return the iterator, equal to 'end()' if the map is empty
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::begin()
+{
+	return iterator(first_node(), this);
+}
+
+/// Constant version of 'begin()'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::begin() const
+{
+	return const_iterator(first_node(), this);
+}
+
+/// Returns the constant iterator to the pair of the minimal key, equal to 'cend()' if the map is empty.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::cbegin() const
+{
+	return const_iterator(first_node(), this);
+}
+
+/** Returns the iterator past the pair of the maximal key.
+* @return the iterator
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::end()
+{
+	return iterator(nullptr, this);
+}
+
+/// Constant version of 'end()'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::end() const
+{
+	return const_iterator(nullptr, this);
+}
+
+/// Returns the constant iterator past the pair of the maximal key.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::cend() const
+{
+	return const_iterator(nullptr, this);
+}
+
+/** Looks for the node holding the key equivalent to 'key'. Never throws, unless the comparator does.
+* @param const other_key& key - the key to be found, of the key type or of any type the comparator accepts
+* @return a pointer to the node, or nullptr if the key is not present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find_node(const other_key& key) const
+{
+	node* point = root;
+	unsigned depth = 0;
+	while (point != nullptr)
+	{
+		if (key_compare(key, point->data.first))
+			point = point->child[LEFT];
+		else if (key_compare(point->data.first, key))
+			point = point->child[RIGHT];
+		else
+			break;
+		++depth;
+	}
+	statistics.descent(depth);
+	return point;
+}
+
+/** Gives the slot of the lookup cache for 'key': the high bits of its hash spread by Fibonacci hashing. The cache must be enabled.
+* @param const key_type& key - the key
+* @return the index into 'cache'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::cache_slot(const key_type& key) const
+{
+	std::uint64_t hash = std::hash<key_type>{}(key);
+	return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> (64 - cache_bits));
+}
+
+/** Looks for the node holding 'key' through the lookup cache, if it is enabled; a miss descends the tree and remembers the node found.
+* @param const key_type& key - the key to be found
+* @return a pointer to the node, or nullptr if the key is not present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find_cached(const key_type& key) const
+{
+	if constexpr (hashable_key<key_type>::value)
+	{
+		if (not cache.empty())
+		{
+			node*& slot = cache[cache_slot(key)];
+			if (slot != nullptr and not key_compare(key, slot->data.first) and not key_compare(slot->data.first, key))
+			{
+				++hit_count;
+				return slot;
+			}
+			++miss_count;
+			node* point = find_node(key);
+			if (point != nullptr)
+				slot = point;
+			return point;
+		}
+	}
+	return find_node(key);
+}
+
+/** Drops the node indicated by 'point' from the lookup cache. Must be called while the node still holds its key.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the node about to be unlinked or destroyed
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::forget(node* point)
+{
+	if constexpr (hashable_key<key_type>::value)
+	{
+		if (not cache.empty())
+		{
+			node*& slot = cache[cache_slot(point->data.first)];
+			if (slot == point)
+				slot = nullptr;
+		}
+	}
+}
+
+/// Empties every slot of the lookup cache, keeping it enabled. Used where whole trees are replaced or their keys moved out.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::clear_cache()
+{
+	std::fill(cache.begin(), cache.end(), nullptr);
+}
+
+/** Looks for the node holding the least key that is not less than 'key'.
+* @param const other_key& key - the bound, of the key type or of any type the comparator accepts
+* @return a pointer to the node, or nullptr if there is no such key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::lower_bound_node(const other_key& key) const
+{
+	node* point = root, * bound = nullptr;
+	unsigned depth = 0;
+	while (point != nullptr)
+	{
+		if (key_compare(point->data.first, key))
+			point = point->child[RIGHT];
+		else
+		{
+			bound = point;
+			point = point->child[LEFT];
+		}
+		++depth;
+	}
+	statistics.descent(depth);
+	return bound;
+}
+
+/** Looks for the node holding the least key that is greater than 'key'.
+* @param const other_key& key - the bound, of the key type or of any type the comparator accepts
+* @return a pointer to the node, or nullptr if there is no such key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::upper_bound_node(const other_key& key) const
+{
+	node* point = root, * bound = nullptr;
+	unsigned depth = 0;
+	while (point != nullptr)
+	{
+		if (key_compare(key, point->data.first))
+		{
+			bound = point;
+			point = point->child[LEFT];
+		}
+		else
+			point = point->child[RIGHT];
+		++depth;
+	}
+	statistics.descent(depth);
+	return bound;
+}
+
+/** Finds the pair of the key 'key'. Does not throw when the key is missing.
+* @param const key_type& key - the key to be found
+* @return the iterator to the pair, or 'end()' if the key is not present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find(const key_type& key)
+{
+	return iterator(find_node(key), this);
+}
+
+/** Finds the pair of the key equivalent to 'key' of another type. Available if the comparator is transparent.
+* @param const other_key& key - the key to be found
+* @return the iterator to the pair, or 'end()' if the key is not present
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find(const other_key& key)
+{
+	return iterator(find_node(key), this);
+}
+
+/** Checks whether the key 'key' is present in the map.
+* @param const key_type& key - the key to be checked
+* @return true if the key is present, false otherwise
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+bool my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::contains(const key_type& key) const
+{
+	return find_node(key) != nullptr;
+}
+
+/** Checks whether a key equivalent to 'key' of another type is present in the map. Available if the comparator is transparent.
+* @param const other_key& key - the key to be checked
+* @return true if the key is present, false otherwise
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+bool my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::contains(const other_key& key) const
+{
+	return find_node(key) != nullptr;
+}
+
+/** Counts the pairs of the key 'key'.
+* @param const key_type& key - the key to be counted
+* @return 1 if the key is present, 0 otherwise
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::count(const key_type& key) const
+{
+	return find_node(key) != nullptr ? 1 : 0;
+}
+
+/** Counts the pairs of the key equivalent to 'key' of another type. Available if the comparator is transparent.
+* @param const other_key& key - the key to be counted
+* @return 1 if the key is present, 0 otherwise
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::count(const other_key& key) const
+{
+	return find_node(key) != nullptr ? 1 : 0;
+}
+
+/** Returns the iterator to the pair of the least key that is not less than 'key'.
+* @param const key_type& key - the bound
+* @return the iterator, or 'end()' if there is no such key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::lower_bound(const key_type& key)
+{
+	return iterator(lower_bound_node(key), this);
+}
+
+/** Returns the iterator to the pair of the least key that is not less than 'key' of another type. Available if the comparator is transparent.
+* @param const other_key& key - the bound
+* @return the iterator, or 'end()' if there is no such key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::lower_bound(const other_key& key)
+{
+	return iterator(lower_bound_node(key), this);
+}
+
+/** Returns the iterator to the pair of the least key that is greater than 'key'.
+* @param const key_type& key - the bound
+* @return the iterator, or 'end()' if there is no such key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::upper_bound(const key_type& key)
+{
+	return iterator(upper_bound_node(key), this);
+}
+
+/** Returns the iterator to the pair of the least key that is greater than 'key' of another type. Available if the comparator is transparent.
+* @param const other_key& key - the bound
+* @return the iterator, or 'end()' if there is no such key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::upper_bound(const other_key& key)
+{
+	return iterator(upper_bound_node(key), this);
+}
+
+/** Returns the range of the pairs of the key 'key', empty or of a single pair.
+* @param const key_type& key - the key
+* @return the pair of 'lower_bound(key)' and 'upper_bound(key)'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::equal_range(const key_type& key)
+{
+	return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/** Returns the range of the pairs of the key equivalent to 'key' of another type. Available if the comparator is transparent.
+* @param const other_key& key - the key
+* @return the pair of 'lower_bound(key)' and 'upper_bound(key)'
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator, typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::equal_range(const other_key& key)
+{
+	return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/** Accesses the value assigned to key 'key'. Throws if such key is not present; use 'find' where misses are expected.
+* @param const key_type& key - the key that to which the value is assigned whose reference should be accessed
+* @return the value of type mapped_type mapped to the key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+mapped_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::at(const key_type& key)
+{
+	node* point = find_cached(key);
+	if (point == nullptr)
+		throw my_exc(root == nullptr ? error_t::empty_map : error_t::out_of_range);
+	return point->data.second;
+}
+
+/** Accesses the value assigned to the key equivalent to 'key' of another type. Available if the comparator is transparent. Throws if such key is not present.
+* @param const other_key& key - the key that to which the value is assigned whose reference should be accessed
+* @return the value of type mapped_type mapped to the key
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+mapped_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::at(const other_key& key)
+{
+	node* point = find_node(key);
+	if (point == nullptr)
+		throw my_exc(root == nullptr ? error_t::empty_map : error_t::out_of_range);
+	return point->data.second;
+}
+
+/// Constant version of 'find(const key_type&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find(const key_type& key) const
+{
+	return const_iterator(find_node(key), this);
+}
+
+/// Constant version of 'find(const other_key&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find(const other_key& key) const
+{
+	return const_iterator(find_node(key), this);
+}
+
+/// Constant version of 'lower_bound(const key_type&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::lower_bound(const key_type& key) const
+{
+	return const_iterator(lower_bound_node(key), this);
+}
+
+/// Constant version of 'lower_bound(const other_key&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::lower_bound(const other_key& key) const
+{
+	return const_iterator(lower_bound_node(key), this);
+}
+
+/// Constant version of 'upper_bound(const key_type&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::upper_bound(const key_type& key) const
+{
+	return const_iterator(upper_bound_node(key), this);
+}
+
+/// Constant version of 'upper_bound(const other_key&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::upper_bound(const other_key& key) const
+{
+	return const_iterator(upper_bound_node(key), this);
+}
+
+/// Constant version of 'equal_range(const key_type&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator, typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::equal_range(const key_type& key) const
+{
+	return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/// Constant version of 'equal_range(const other_key&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+std::pair<typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator, typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator>
+my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::equal_range(const other_key& key) const
+{
+	return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+/// Constant version of 'at(const key_type&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+const mapped_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::at(const key_type& key) const
+{
+	node* point = find_cached(key);
+	if (point == nullptr)
+		throw my_exc(root == nullptr ? error_t::empty_map : error_t::out_of_range);
+	return point->data.second;
+}
+
+/// Constant version of 'at(const other_key&)'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class other_key, class>
+const mapped_type& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::at(const other_key& key) const
+{
+	node* point = find_node(key);
+	if (point == nullptr)
+		throw my_exc(root == nullptr ? error_t::empty_map : error_t::out_of_range);
+	return point->data.second;
+}
+
+/** Looks up the keys of [first, last) and calls 'emit' with the node of every key, or nullptr, in the order of the keys. The keys are taken
+* in groups of FIND_MANY_LANES whose descents advance in lock-step, one level per round; the next node of every descent is prefetched and
+* not compared until the other descents of the group have taken their step, so that the cache misses of the group overlap.
+* @param key_iterator first - the forward iterator to the first key
+* @param key_iterator last - the iterator past the last key
+* @param function_type emit - callable taking my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node*
+* @return the number of keys found
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class key_iterator, class function_type>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find_nodes(key_iterator first, key_iterator last, function_type emit) const
+{
+	size_t found = 0;
+	key_iterator keys[FIND_MANY_LANES];
+	node* cursor[FIND_MANY_LANES];
+	unsigned depth[FIND_MANY_LANES];
+	bool done[FIND_MANY_LANES];
+	while (first != last)
+	{
+		size_t lanes = 0;
+		for (; lanes < FIND_MANY_LANES and first != last; ++lanes, ++first)
 		{
-			if (point == root)
-			{
-				root = point->child[LEFT];
-				point->child[LEFT]->parent = nullptr;
-				point.reset();
-			}
-			else
+			keys[lanes] = first;
+			cursor[lanes] = root;
+			depth[lanes] = 0;
+			done[lanes] = (root == nullptr);
+		}
+		for (size_t pending = lanes; pending != 0; )
+		{
+			pending = 0;
+			for (size_t i = 0; i < lanes; ++i)
 			{
-				if (point->child[LEFT]->colour == RED)
+				if (done[i])
+					continue;
+				node* point = cursor[i];
+				if (key_compare(*keys[i], point->data.first))
+					point = point->child[LEFT];
+				else if (key_compare(point->data.first, *keys[i]))
+					point = point->child[RIGHT];
+				else
 				{
-					point->child[LEFT]->colour = BLACK;
-					point->parent->child[which_child(point)] = point->child[LEFT];
-					point->child[LEFT]->parent = point->parent;
-					point.reset();
+					done[i] = true;
+					continue;
 				}
+				cursor[i] = point;
+				++depth[i];
+				if (point == nullptr)
+					done[i] = true;
 				else
 				{
-					point->child[LEFT]->colour = DOUBLE_BLACK;
-					point->parent->child[which_child(point)] = point->child[LEFT];
-					point->child[LEFT]->parent = point->parent;
-					resolve_double_black(point->child[LEFT]);
-					point.reset();
+					prefetch_line(point);
+					++pending;
 				}
 			}
 		}
-		else // both children
+		for (size_t i = 0; i < lanes; ++i)
 		{
-			std::shared_ptr<node> replacer = predecessor(point);
-			std::swap(replacer->data, point->data);
-			erase(replacer);
+			statistics.descent(depth[i]);
+			found += (cursor[i] != nullptr ? 1 : 0);
+			emit(cursor[i]);
 		}
 	}
+	return found;
 }
 
-/** Erases the node that holds 'key' as key if such is present in the tree.
-* @param const key_type& key - the key of the node to be erased
+/** Looks up many keys at once, much faster than 'find' in a loop on trees that do not fit in the cache, see 'find_nodes'.
+* Writes an iterator for every key, in the order of the keys: the position of the key, or 'end()' if it is not present.
+* @param key_iterator first - the forward iterator to the first key
+* @param key_iterator last - the iterator past the last key
+* @param output_iterator out - the output iterator receiving iterators
+* @return the number of keys found
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class key_iterator, class output_iterator>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find_many(key_iterator first, key_iterator last, output_iterator out)
+{
+	return find_nodes(first, last, [&](node* point) { *out++ = iterator(point, this); });
+}
+
+/// Constant version of 'find_many', writing const_iterator.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class key_iterator, class output_iterator>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::find_many(key_iterator first, key_iterator last, output_iterator out) const
+{
+	return find_nodes(first, last, [&](node* point) { *out++ = const_iterator(point, this); });
+}
+
+/** Enables the lookup cache in front of 'at(const key_type&)', which pays off when a few hot keys take most of the lookups.
+* The cache is direct-mapped: a key hashes to one of 'slots' slots, rounded up to a power of two, that remembers the node last found there.
+* A hit costs one hash and one comparison pair instead of a descent; modifications of the map drop the affected slots.
+* Since 'at' then writes to the cache even when called on a constant map, concurrent readers must not share a map with the cache enabled.
+* Requires std::hash of the key type.
+* @param size_t slots - the number of slots, 0 disables the cache
 * @return void
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::erase(const key_type& key)
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::enable_cache(size_t slots)
 {
-	if (root == nullptr)
+	static_assert(hashable_key<key_type>::value, "the lookup cache requires std::hash<key_type>");
+	cache.clear();
+	cache_bits = 0;
+	hit_count = miss_count = 0;
+	if (slots == 0)
+	{
+		cache.shrink_to_fit();
 		return;
-	std::shared_ptr<node> point = root;
-	while (key != point->data.first)
+	}
+	while ((size_t(1) << cache_bits) < slots)
+		++cache_bits;
+	if (cache_bits == 0)
+		cache_bits = 1;
+	cache.assign(size_t(1) << cache_bits, nullptr);
+}
+
+/** Gives the number of lookups answered by the cache since it was enabled.
+* @return the number of hits
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::cache_hits() const
+{
+	return hit_count;
+}
+
+/** Gives the number of cached lookups that had to descend the tree since the cache was enabled.
+* @return the number of misses
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::cache_misses() const
+{
+	return miss_count;
+}
+
+/** Calls 'function' on every pair whose key lies in [low, high), in the ascending order of keys.
+* The scan walks the links of the nodes, so it neither allocates nor throws, unless 'function' does. The tree must not be modified by 'function'.
+* @param const key_type& low - the least key of the range
+* @param const key_type& high - the key past the range
+* @param function_type function - callable taking std::pair<key_type, mapped_type>&
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class function_type>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::for_each_in_range(const key_type& low, const key_type& high, function_type function)
+{
+	for (node* point = lower_bound_node(low); point != nullptr and key_compare(point->data.first, high); point = successor(point))
+		function(point->data);
+}
+
+/// Constant version of 'for_each_in_range'; 'function' takes const std::pair<key_type, mapped_type>&.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class function_type>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::for_each_in_range(const key_type& low, const key_type& high, function_type function) const
+{
+	for (node* point = lower_bound_node(low); point != nullptr and key_compare(point->data.first, high); point = successor(point))
+		function(static_cast<const value_type&>(point->data));
+}
+
+/** Returns the number of keys less than 'key', in O(log n). Requires an augmentation policy keeping subtree sizes, e.g. subtree_size.
+* @param const key_type& key - the bound, not necessarily present in the map
+* @return the number of lesser keys
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::rank(const key_type& key) const
+{
+	size_t result = 0;
+	for (node* point = root; point != nullptr; )
 	{
-		if (key < point->data.first)
+		if (key_compare(point->data.first, key))
 		{
-			if (point->child[LEFT] == nullptr)
-				return;
-			else
-				point = point->child[LEFT];
+			result += augment_policy::size(summary_of(point->child[LEFT])) + 1;
+			point = point->child[RIGHT];
 		}
 		else
-		{
-			if (point->child[RIGHT] == nullptr)
-				return;
-			else
-				point = point->child[RIGHT];
-		}
+			point = point->child[LEFT];
 	}
-	erase(point);
+	return result;
 }
 
-/** Returns the pair of the maximal key and its mapped value.
-* @return pair of type std::pair<key_type, mapped_type> of the maximal key and its mapped value
+/** Returns the iterator to the pair with exactly 'index' lesser keys, in O(log n). Requires an augmentation policy keeping subtree sizes.
+* @param size_t index - the position of the pair in the ascending order, counted from 0
+* @return the iterator to the pair or end() if 'index' is not less than the size
 */
-template<class key_type, class mapped_type>
-typename my_map<key_type, mapped_type>::value_type my_map<key_type, mapped_type>::max()
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::select(size_t index)
 {
-	if (root == nullptr)
-		throw my_exc(error_t::empty_map);
-	std::shared_ptr<node> point = root;
-	while (point->child[RIGHT] != nullptr)
-		point = point->child[RIGHT];
-	return point->data;
+	node* point = root;
+	while (point != nullptr)
+	{
+		size_t left_size = augment_policy::size(summary_of(point->child[LEFT]));
+		if (index < left_size)
+			point = point->child[LEFT];
+		else if (index == left_size)
+			break;
+		else
+		{
+			index -= left_size + 1;
+			point = point->child[RIGHT];
+		}
+	}
+	return iterator(point, this);
 }
 
-/** Returns the pair of the minimal key and its mapped value.
-* @return pair of type std::pair<key_type, mapped_type> of the minimal key and its mapped value
-*/
-template<class key_type, class mapped_type>
-typename my_map<key_type, mapped_type>::value_type my_map<key_type, mapped_type>::min()
+/// Constant version of 'select'.
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::const_iterator my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::select(size_t index) const
 {
-	if (root == nullptr)
-		throw my_exc(error_t::empty_map);
-	std::shared_ptr<node> point = root;
-	while (point->child[LEFT] != nullptr)
-		point = point->child[LEFT];
-	return point->data;
+	return const_cast<my_map*>(this)->select(index);
 }
 
-/** Accesses the value assigned to key 'key'. Throws if such key is not present.
-* @param key_type key - the key that to which the value is assigned whose reference should be accessed
-* @return the value of type mapped_type mapped to the key
+/** Combines the summaries of all the pairs whose keys lie in [low, high), in the ascending order of keys, in O(log n):
+* whole subtrees hanging off the two boundary paths are taken from their roots. Requires an enabled augmentation policy.
+* @param const key_type& low - the least key of the range
+* @param const key_type& high - the key past the range
+* @return the aggregate of the range, e.g. the sum of the mapped values for sized_aggregate<mapped_sum<...>>
 */
-template<class key_type, class mapped_type>
-mapped_type& my_map<key_type, mapped_type>::at(key_type key)
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+typename augment_policy::aggregate_type my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::aggregate(const key_type& low, const key_type& high) const
 {
-	if (root == nullptr)
-		throw my_exc(error_t::empty_map);
-	std::shared_ptr<node> point = root;
-	while (true)
+	static_assert(augment_policy::enabled, "Aggregates require an augmentation policy.");
+	node* split = root;
+	while (split != nullptr)
 	{
-		if (point->data.first == key)
-			return point->data.second;
-		dir_t side = (key < point->data.first ? LEFT : RIGHT);
-		if (point->child[side] == nullptr)
-			throw my_exc(error_t::out_of_range);
+		if (key_compare(split->data.first, low))
+			split = split->child[RIGHT];
+		else if (not key_compare(split->data.first, high))
+			split = split->child[LEFT];
+		else
+			break;
+	}
+	if (split == nullptr)
+		return augment_policy::aggregate(augment_policy::identity());
+	typename augment_policy::summary_type left = augment_policy::identity(), right = augment_policy::identity();
+	for (node* point = split->child[LEFT]; point != nullptr; )
+	{
+		if (key_compare(point->data.first, low))
+			point = point->child[RIGHT];
+		else
+		{
+			left = augment_policy::combine(augment_policy::combine(augment_policy::summarize(point->data), summary_of(point->child[RIGHT])), left);
+			point = point->child[LEFT];
+		}
+	}
+	for (node* point = split->child[RIGHT]; point != nullptr; )
+	{
+		if (key_compare(point->data.first, high))
+		{
+			right = augment_policy::combine(right, augment_policy::combine(summary_of(point->child[LEFT]), augment_policy::summarize(point->data)));
+			point = point->child[RIGHT];
+		}
 		else
-			point = point->child[side];
+			point = point->child[LEFT];
 	}
+	return augment_policy::aggregate(augment_policy::combine(augment_policy::combine(left, augment_policy::summarize(split->data)), right));
 }
 
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::serialize(std::shared_ptr<node> point, std::ofstream& file)
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::serialize(node* point, std::ofstream& file)
 {
 	if (point != nullptr)
 	{
-		file << point->data.first << ' ' << point->data.second << '\n';
 		if (point->child[LEFT] != nullptr)
 			serialize(point->child[LEFT], file);
+		file << point->data.first << ' ' << point->data.second << '\n';
 		if (point->child[RIGHT] != nullptr)
 			serialize(point->child[RIGHT], file);
 	}
 }
 
-/** Serializes the contents of the map to the output file stream.
+/** Serializes the contents of the map to the output file stream. The pairs are written in the ascending order of keys,
+* so that 'deserialize' can rebuild the tree in linear time.
 * @param ofstream& file - the output file stream the contents are serialized to
 * @return void
 */
-// Under development.
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::serialize(const std::string& name)
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::serialize(const std::string& name)
 {
 	std::ofstream file;
 	file.open(name, std::ios::out);
@@ -647,37 +3848,211 @@ void my_map<key_type, mapped_type>::serialize(const std::string& name)
 	file.close();
 }
 
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::deserialize(const std::string& name)
+/** Serializes the contents of the map to the file 'name' on a background thread, in the format of 'serialize'. The caller is held only
+* while the pairs are copied into a flat array, a sequential pass far cheaper than formatting and writing them; the map may be modified
+* as soon as the call returns, the file holds the contents of that moment.
+* @param const std::string& name - the name of the file
+* @return the future of the report with the size of the file, the number of pairs and the times taken; it rethrows a failure of writing
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+std::future<serialize_report> my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::serialize_async(const std::string& name) const
+{
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<value_type> pairs;
+	pairs.reserve(number_of_nodes);
+	for (node* point = first_node(); point != nullptr; point = successor(point))
+		pairs.push_back(point->data);
+	double capture_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return std::async(std::launch::async, [name, pairs = std::move(pairs), capture_seconds]()
+		{
+			serialize_report report = write_pairs(name, pairs.begin(), pairs.end());
+			report.capture_seconds = capture_seconds;
+			return report;
+		});
+}
+
+/** Builds the subtree of 'count' consecutive pairs starting at 'first'. The subtree is perfectly balanced and the balancing policy sets the balance
+* of every node once its children are built; in a red-black tree the nodes at depth 'red_depth' are red, the others black.
+* @param iterator_type& first - the iterator to the first pair of the subtree, advanced past its last pair
+* @param size_t count - the number of pairs in the subtree
+* @param unsigned depth - the depth of the subtree's root
+* @param unsigned red_depth - the depth of the lowest level of the whole tree
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* parent - the pointer to the parent of the subtree's root
+* @return a pointer to the root of the subtree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class iterator_type>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::build(iterator_type& first, size_t count, unsigned depth, unsigned red_depth, node* parent)
 {
-	std::ifstream file;
-	file.open(name, std::ios::out);
-	if (file.good())
+	if (count == 0)
+		return nullptr;
+	size_t left_count = (count - 1) / 2;
+	node* left = build(first, left_count, depth + 1, red_depth, nullptr);
+	node* point;
+	try
 	{
-		value_type value;
-		while ((file >> value.first) and (file >> value.second))
-			insert(value);
+		if constexpr (std::is_constructible<value_type, decltype(*first)>::value)
+			point = create_node(parent, *first);
+		else
+			point = create_node(parent, first->first, first->second);
 	}
-	file.close();
+	catch (...)
+	{
+		destroy(left);
+		throw;
+	}
+	++first;
+	point->child[LEFT] = left;
+	if (left != nullptr)
+		left->parent = point;
+	try
+	{
+		point->child[RIGHT] = build(first, count - 1 - left_count, depth + 1, red_depth, point);
+	}
+	catch (...)
+	{
+		destroy(point);
+		throw;
+	}
+	balance_policy::build(point, depth, red_depth);
+	update(point);
+	return point;
+}
+
+/** Builds a detached tree of 'count' consecutive pairs starting at 'first' in linear time. The map is not touched,
+* so if a pair or a node cannot be created, the map stays as it was and nothing is leaked.
+* @param iterator_type first - the forward iterator to the first pair; a move iterator moves the pairs into the nodes
+* @param size_t count - the number of pairs, at least one
+* @return a pointer to the root of the new tree
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class iterator_type>
+typename my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::build_tree(iterator_type first, size_t count)
+{
+	unsigned height = 0;
+	while ((count >> height) > 1)
+		++height;
+	node* tree = build(first, count, 0, height, nullptr);
+	balance_policy::make_root(tree);
+	return tree;
+}
+
+/** Makes the detached tree 'tree' the tree of the map and destroys the previous one. Does not throw.
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* tree - the pointer to the root of the new tree or nullptr
+* @param size_t count - the number of nodes of 'tree'
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::replace_tree(node* tree, size_t count)
+{
+	clear_cache();
+	destroy(root);
+	root = tree;
+	find_extremes();
+	number_of_nodes = count;
+}
+
+/** Builds the tree from the range [first, last) in linear time. The range has to be sorted in the ascending order of keys
+* and must not contain repeated keys. Throws if the map is not empty.
+* @param iterator_type first - the forward iterator to the first pair
+* @param iterator_type last - the iterator past the last pair
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template<class iterator_type>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::build(iterator_type first, iterator_type last)
+{
+	if (root != nullptr)
+		throw my_exc(error_t::non_empty_map);
+	size_t count = std::distance(first, last);
+	if (count == 0)
+		return;
+	replace_tree(build_tree(first, count), count);
+}
+
+/** Puts the pairs in 'values' into the map. If 'values' is not sorted, it is sorted once; of repeated keys the first one is kept,
+* as 'insert' would do. The contents of a non-empty map are merged with 'values' and the tree is rebuilt, the present pairs take precedence.
+* The present pairs are copied and the new tree is built aside, so the map is left unchanged if anything throws.
+* @param std::vector<std::pair<key_type, mapped_type>>& values - the pairs to be put, left in an unspecified state
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::assign_sorted(std::vector<value_type>& values)
+{
+	auto key_less = [this](const value_type& a, const value_type& b) { return key_compare(a.first, b.first); };
+	auto key_equal = [this](const value_type& a, const value_type& b) { return not key_compare(a.first, b.first) and not key_compare(b.first, a.first); };
+	if (std::adjacent_find(values.begin(), values.end(), [this](const value_type& a, const value_type& b) { return not key_compare(a.first, b.first); }) != values.end())
+	{
+		std::stable_sort(values.begin(), values.end(), key_less);
+		values.erase(std::unique(values.begin(), values.end(), key_equal), values.end());
+	}
+	if (values.empty())
+		return;
+	if (root != nullptr)
+	{
+		std::vector<value_type> merged;
+		merged.reserve(number_of_nodes + values.size());
+		node* old = first_node();
+		auto added = values.begin();
+		while (old != nullptr and added != values.end())
+		{
+			if (key_less(*added, old->data))
+				merged.push_back(std::move(*added++));
+			else
+			{
+				if (not key_less(old->data, *added))
+					++added;
+				merged.push_back(old->data);
+				old = successor(old);
+			}
+		}
+		for (; old != nullptr; old = successor(old))
+			merged.push_back(old->data);
+		std::move(added, values.end(), std::back_inserter(merged));
+		values.swap(merged);
+	}
+	replace_tree(build_tree(std::make_move_iterator(values.begin()), values.size()), values.size());
+}
+
+/** Deserializes the contents of the file 'name', written by 'serialize', into the map.
+* The pairs are parsed in parallel by 'read_text_pairs' and the tree is built in linear time, the input is sorted first only if it is not sorted already.
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::deserialize(const std::string& name)
+{
+	std::vector<value_type> values;
+	if (read_text_pairs(name, values))
+		assign_sorted(values);
 }
 
 /** Returns the information whether the map is empty.
 * @return true if the map is empty, false otherwise
 */
-template<class key_type, class mapped_type>
-bool my_map<key_type, mapped_type>::empty()
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+bool my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::empty() const
 {
 	return !root;
 }
 
+/** Returns the number of pairs in the map.
+* @return the number of pairs
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::size() const
+{
+	return number_of_nodes;
+}
+
 /** Prints information about the node and its children to the console.
-* @param std::shared_ptr<my_map<key_type, mapped_type>::node> point - the pointer to the node to be printed
+* @param my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node* point - the pointer to the node to be printed
 * @param unsigned& level - the number of the node's ancestors
 * @param int8_t dir - information wheter the node is the left (LEFT) or the right child (RIGHT)
 * @return void
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::print_node(std::shared_ptr<node> point, unsigned& level, unsigned& black_depth, dir_t& dir)
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::print_node(node* point, unsigned& level, unsigned& black_depth, dir_t& dir)
 {
 	for (unsigned i = 1; i < level; ++i)
 		std::cout << "      ";
@@ -687,26 +4062,23 @@ void my_map<key_type, mapped_type>::print_node(std::shared_ptr<node> point, unsi
 		std::cout << " <r> ";
 	if (point == nullptr)
 	{
-		std::cout << "nul, " << black_depth + 1 << std::endl;
+		std::cout << "nul";
+		if (balance_policy::coloured)
+			std::cout << ", " << black_depth + 1;
+		std::cout << std::endl;
 		--level;
 	}
 	else
 	{
-		std::cout << "[" << point->data.first << ", " << point->data.second << "], ";
-		if (point->colour == RED)
-			std::cout << "red" << std::endl;
-		else if (point->colour == BLACK)
-			std::cout << "black" << std::endl;
-		else
-			std::cout << "double_black" << std::endl;
+		std::cout << "[" << point->data.first << ", " << point->data.second << "], " << balance_policy::name(point->balance) << std::endl;
 		dir = LEFT;
-		if (point->colour == BLACK)
+		if (balance_policy::coloured and point->balance == BLACK)
 			++black_depth;
 		print_node(point->child[LEFT], ++level, black_depth, dir);
 		dir = RIGHT;
 		print_node(point->child[RIGHT], ++level, black_depth, dir);
 		--level;
-		if (point->colour == BLACK)
+		if (balance_policy::coloured and point->balance == BLACK)
 			--black_depth;
 	}
 }
@@ -714,11 +4086,425 @@ void my_map<key_type, mapped_type>::print_node(std::shared_ptr<node> point, unsi
 /** Prints the contents of the map to the console.
 * @return void
 */
-template<class key_type, class mapped_type>
-void my_map<key_type, mapped_type>::print()
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::print()
 {
 	std::cout << "root: ";
 	unsigned depth = 0, black_height = 0;
 	dir_t which = ROOT;
 	print_node(root, depth, black_height, which);
 }
+
+/** Gathers the figures of the shape and of the memory of the tree in one O(n) walk along the parent links, with no recursion
+* and no memory beyond the depth histogram, so it suits large maps; nothing is printed. See 'inspection_report'.
+* @param bool locality - whether to count the child links that stay within one cache line or one page, which reads the node addresses only
+* @return the report
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+inspection_report my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::inspect(bool locality) const
+{
+	inspection_report report;
+	report.locality = locality;
+	if constexpr (balance_policy::coloured)
+		report.black_height = balance_policy::rank(root);
+	const node* point = root, * previous = nullptr;
+	unsigned depth = 0;
+	while (point != nullptr)
+	{
+		const node* next;
+		if (previous == point->parent)
+		{
+			++report.nodes;
+			if constexpr (balance_policy::coloured)
+				++(point->balance == RED ? report.red_nodes : report.black_nodes);
+			report.total_depth += depth;
+			if (depth >= report.depth_histogram.size())
+				report.depth_histogram.resize(depth + 1);
+			++report.depth_histogram[depth];
+			for (const node* child : point->child)
+				if (locality and child != nullptr)
+				{
+					uintptr_t from = reinterpret_cast<uintptr_t>(point), to = reinterpret_cast<uintptr_t>(child);
+					++report.child_links;
+					report.same_line_links += (from / 64 == to / 64 ? 1 : 0);
+					report.same_page_links += (from / 4096 == to / 4096 ? 1 : 0);
+				}
+			next = (point->child[LEFT] != nullptr ? point->child[LEFT] : point->child[RIGHT]);
+		}
+		else if (previous == point->child[LEFT])
+			next = point->child[RIGHT];
+		else
+			next = nullptr;
+		previous = point;
+		if (next != nullptr)
+		{
+			point = next;
+			++depth;
+		}
+		else
+		{
+			point = point->parent;
+			--depth;
+		}
+	}
+	report.height = unsigned(report.depth_histogram.size());
+	report.average_depth = (report.nodes == 0 ? 0.0 : double(report.total_depth) / report.nodes);
+	report.node_bytes = report.nodes * sizeof(node);
+	report.payload_bytes = report.nodes * sizeof(value_type);
+	report.link_bytes = report.nodes * node_overhead();
+	report.allocator_bytes = report.node_bytes;
+	if constexpr (reports_reserved<node_allocator_type>::value)
+		report.allocator_bytes = node_allocator.bytes_reserved();
+	report.cache_bytes = cache.capacity() * sizeof(node*);
+	return report;
+}
+
+/** Returns the number of bytes each node occupies beyond the stored pair: the links, the balance, the summary of the augmentation and the padding.
+* Nodes live in the slots of the node allocator, so there is no separate control block nor heap header per node.
+* @return the per-node overhead in bytes
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+constexpr size_t my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::node_overhead()
+{
+	return sizeof(node) - sizeof(value_type);
+}
+
+/** Returns the statistics policy that has been notified of the rebalancing work, e.g. counting_stats.
+* @return constant reference to the policy object
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+const stats_policy& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::stats() const
+{
+	return statistics;
+}
+
+/** Returns the statistics policy, e.g. to reset the counters.
+* @return reference to the policy object
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+stats_policy& my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::stats()
+{
+	return statistics;
+}
+
+/** Writes the contents of the map to the binary snapshot file 'name': the header, the records sorted by key and, optionally,
+* the checksums of the blocks of records. The snapshot can be served by 'my_map_view' directly from the mapped file.
+* Available only for trivially copyable keys and mapped values. Throws if the file cannot be written.
+* @param const std::string& name - the name of the file
+* @param bool checksums - whether the checksums should be written, true by default
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::save_snapshot(const std::string& name, bool checksums)
+{
+	static_assert(std::is_trivially_copyable<key_type>::value and std::is_trivially_copyable<mapped_type>::value,
+		"Binary snapshots require trivially copyable keys and mapped values.");
+	using record = snapshot_record<key_type, mapped_type>;
+	snapshot_header header{};
+	std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.flags = checksums ? SNAPSHOT_CHECKSUMS : 0;
+	header.key_size = sizeof(key_type);
+	header.mapped_size = sizeof(mapped_type);
+	header.record_size = sizeof(record);
+	header.count = number_of_nodes;
+	header.records_per_block = SNAPSHOT_RECORDS_PER_BLOCK;
+	header.records_offset = (sizeof(snapshot_header) + alignof(record) - 1) / alignof(record) * alignof(record);
+	header.checksums_offset = (header.records_offset + header.count * sizeof(record) + 7) / 8 * 8;
+
+	std::ofstream file(name, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (not file.good())
+		throw my_exc(error_t::bad_file);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	const char padding[64] = {};
+	file.write(padding, header.records_offset - sizeof(header));
+
+	std::vector<record> block(SNAPSHOT_RECORDS_PER_BLOCK);
+	std::vector<uint64_t> sums;
+	size_t filled = 0, written = 0;
+	for (node* point = first_node(); point != nullptr; point = successor(point))
+	{
+		block[filled].first = point->data.first;
+		block[filled].second = point->data.second;
+		++written;
+		if (++filled == block.size() or written == number_of_nodes)
+		{
+			file.write(reinterpret_cast<const char*>(block.data()), filled * sizeof(record));
+			if (checksums)
+				sums.push_back(snapshot_checksum(block.data(), filled * sizeof(record)));
+			filled = 0;
+		}
+	}
+	if (checksums)
+	{
+		file.write(padding, header.checksums_offset - header.records_offset - header.count * sizeof(record));
+		file.write(reinterpret_cast<const char*>(sums.data()), sums.size() * sizeof(uint64_t));
+	}
+	if (not file.good())
+		throw my_exc(error_t::bad_file);
+	file.close();
+}
+
+/** Loads the binary snapshot file 'name' into the map. The file is mapped into memory and its checksums, if present, are verified.
+* An empty map is built directly from the sorted records in linear time; the contents of a non-empty map are merged with them,
+* the present pairs take precedence. Throws if the file is missing, damaged or written for other types.
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::load_snapshot(const std::string& name)
+{
+	my_map_view<key_type, mapped_type, compare> view(name);
+	if (not view.verify())
+		throw my_exc(error_t::bad_file);
+	if (root == nullptr)
+		build(view.begin(), view.end());
+	else
+	{
+		std::vector<value_type> values;
+		values.reserve(view.size());
+		for (const auto& item : view)
+			values.emplace_back(item.first, item.second);
+		assign_sorted(values);
+	}
+}
+
+/** Saves the contents of the map to the compressed snapshot file 'name': the keys, in the order of the map, as varint differences
+* in blocks of COMPRESSED_PAIRS_PER_BLOCK pairs with a block index, the mapped values encoded by 'value_codec'. Dense keys take one byte each.
+* Throws if the file cannot be written.
+* @param value_codec - the codec of the mapped values, raw_codec or varint_codec
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class value_codec>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::save_compressed(const std::string& name)
+{
+	static_assert(std::is_integral<key_type>::value and sizeof(key_type) <= sizeof(uint64_t), "Compressed snapshots require integral keys.");
+	compressed_header header{};
+	std::memcpy(header.magic, COMPRESSED_MAGIC, sizeof(header.magic));
+	header.version = COMPRESSED_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.key_size = sizeof(key_type);
+	header.codec = value_codec::id;
+	header.count = number_of_nodes;
+	header.pairs_per_block = COMPRESSED_PAIRS_PER_BLOCK;
+	header.blocks = (number_of_nodes + COMPRESSED_PAIRS_PER_BLOCK - 1) / COMPRESSED_PAIRS_PER_BLOCK;
+
+	std::ofstream file(name, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (not file.good())
+		throw my_exc(error_t::bad_file);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	std::vector<compressed_block> index;
+	index.reserve(header.blocks);
+	std::vector<unsigned char> block;
+	uint64_t offset = sizeof(header), previous = 0;
+	node* point = first_node();
+	while (point != nullptr)
+	{
+		block.clear();
+		previous = static_cast<uint64_t>(point->data.first);
+		index.push_back(compressed_block{ previous, offset, 0 });
+		for (uint64_t i = 0; i < COMPRESSED_PAIRS_PER_BLOCK and point != nullptr; ++i, point = successor(point))
+		{
+			uint64_t key = static_cast<uint64_t>(point->data.first);
+			put_varint(zigzag(key - previous), block);
+			value_codec::encode(point->data.second, block);
+			previous = key;
+		}
+		index.back().checksum = snapshot_checksum(block.data(), block.size());
+		file.write(reinterpret_cast<const char*>(block.data()), block.size());
+		offset += block.size();
+	}
+	header.index_offset = offset;
+	file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(compressed_block));
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (not file.good())
+		throw my_exc(error_t::bad_file);
+	file.close();
+}
+
+/** Loads the compressed snapshot file 'name', written by 'save_compressed' with the same codec. The file is mapped into memory, every block
+* is verified against its checksum and decoded, and an empty map is built directly from the pairs in linear time; the contents of
+* a non-empty map are merged with them, the present pairs take precedence. Throws if the file is missing, damaged or written for other types;
+* a header claiming more pairs than the file has bytes is rejected before anything is reserved, as every pair takes at least one byte.
+* @param value_codec - the codec of the mapped values the file was written with
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template<class key_type, class mapped_type, class compare, class allocator_type, class stats_policy, class augment_policy, class balance_policy>
+template <class value_codec>
+void my_map<key_type, mapped_type, compare, allocator_type, stats_policy, augment_policy, balance_policy>::load_compressed(const std::string& name)
+{
+	static_assert(std::is_integral<key_type>::value and sizeof(key_type) <= sizeof(uint64_t), "Compressed snapshots require integral keys.");
+	mapped_file file(name);
+	compressed_header header;
+	if (not file.is_open() or file.size() < sizeof(header))
+		throw my_exc(error_t::bad_file);
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, COMPRESSED_MAGIC, sizeof(header.magic)) != 0 or header.version != COMPRESSED_VERSION
+		or header.byte_order != SNAPSHOT_BYTE_ORDER or header.key_size != sizeof(key_type) or header.codec != value_codec::id
+		or header.count > file.size() or header.pairs_per_block == 0
+		or header.blocks != header.count / header.pairs_per_block + (header.count % header.pairs_per_block != 0 ? 1 : 0)
+		or header.index_offset > file.size() or header.blocks > (file.size() - header.index_offset) / sizeof(compressed_block))
+		throw my_exc(error_t::bad_file);
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.data());
+	std::vector<compressed_block> index(static_cast<size_t>(header.blocks));
+	if (not index.empty())
+		std::memcpy(index.data(), bytes + header.index_offset, index.size() * sizeof(compressed_block));
+	std::vector<value_type> values;
+	values.reserve(static_cast<size_t>(header.count));
+	for (size_t b = 0; b < index.size(); ++b)
+	{
+		uint64_t end = (b + 1 < index.size() ? index[b + 1].offset : header.index_offset);
+		if (index[b].offset < sizeof(header) or index[b].offset > end or end > header.index_offset
+			or snapshot_checksum(bytes + index[b].offset, end - index[b].offset) != index[b].checksum)
+			throw my_exc(error_t::bad_file);
+		const unsigned char* in = bytes + index[b].offset, * last = bytes + end;
+		uint64_t key = index[b].first_key, pairs = std::min(header.pairs_per_block, header.count - b * header.pairs_per_block);
+		for (uint64_t i = 0; i < pairs; ++i)
+		{
+			uint64_t difference;
+			mapped_type mapped;
+			if (not get_varint(in, last, difference) or not value_codec::decode(in, last, mapped))
+				throw my_exc(error_t::bad_file);
+			key += unzigzag(difference);
+			values.emplace_back(static_cast<key_type>(key), std::move(mapped));
+		}
+	}
+	if (root == nullptr)
+		build(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+	else
+		assign_sorted(values);
+}
+
+/** Read-only map served directly from a binary snapshot file written by 'my_map::save_snapshot'. The file is mapped into memory
+* and the lookups are binary searches in the sorted array of records, so no nodes are materialised.
+* @param key_type - the type used as the key, trivially copyable
+* @param mapped_type - the type of data assigned to the keys, trivially copyable
+* @param compare - the ordering the snapshot was sorted with, std::less<key_type> by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>>
+class my_map_view
+{
+	static_assert(std::is_trivially_copyable<key_type>::value and std::is_trivially_copyable<mapped_type>::value,
+		"Binary snapshots require trivially copyable keys and mapped values.");
+public:
+	using record = snapshot_record<key_type, mapped_type>;
+private:
+	mapped_file file;
+	compare key_compare;
+	const snapshot_header* header;
+	const record* records;
+	size_t count;
+public:
+	explicit my_map_view(const std::string& name);
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const record* begin() const { return records; }
+	const record* end() const { return records + count; }
+	const record* find(const key_type& key) const;
+	const mapped_type& at(const key_type& key) const;
+	const record& min() const;
+	const record& max() const;
+	bool verify() const;
+};
+
+/** Constructor of class my_map_view<key_type, mapped_type, compare>. Maps the file 'name' and checks its header.
+* Throws if the file is missing, truncated or written for other types, or if its header is damaged - e.g. checksums flagged with no records
+* per block, which is rejected before the number of blocks is computed.
+* @param const std::string& name - the name of the file
+*/
+template <class key_type, class mapped_type, class compare>
+my_map_view<key_type, mapped_type, compare>::my_map_view(const std::string& name) : file(name)
+{
+	if (not file.is_open() or file.size() < sizeof(snapshot_header))
+		throw my_exc(error_t::bad_file);
+	header = reinterpret_cast<const snapshot_header*>(file.data());
+	if (std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 or header->version != SNAPSHOT_VERSION
+		or header->byte_order != SNAPSHOT_BYTE_ORDER or header->key_size != sizeof(key_type)
+		or header->mapped_size != sizeof(mapped_type) or header->record_size != sizeof(record)
+		or header->records_offset % alignof(record) != 0 or header->records_offset > file.size()
+		or header->count > (file.size() - header->records_offset) / sizeof(record))
+		throw my_exc(error_t::bad_file);
+	if (header->flags & SNAPSHOT_CHECKSUMS)
+	{
+		if (header->records_per_block == 0 or header->checksums_offset % 8 != 0 or header->checksums_offset > file.size())
+			throw my_exc(error_t::bad_file);
+		uint64_t blocks = header->count / header->records_per_block + (header->count % header->records_per_block != 0 ? 1 : 0);
+		if (blocks > (file.size() - header->checksums_offset) / sizeof(uint64_t))
+			throw my_exc(error_t::bad_file);
+	}
+	records = reinterpret_cast<const record*>(file.data() + header->records_offset);
+	count = static_cast<size_t>(header->count);
+}
+
+/** Finds the record of the key 'key' with binary search.
+* @param const key_type& key - the key to be found
+* @return a pointer to the record, or nullptr if the key is not present
+*/
+template <class key_type, class mapped_type, class compare>
+const typename my_map_view<key_type, mapped_type, compare>::record* my_map_view<key_type, mapped_type, compare>::find(const key_type& key) const
+{
+	const record* found = std::lower_bound(begin(), end(), key,
+		[this](const record& item, const key_type& value) { return key_compare(item.first, value); });
+	if (found == end() or key_compare(key, found->first))
+		return nullptr;
+	return found;
+}
+
+/** Accesses the value assigned to key 'key'. Throws if such key is not present.
+* @param const key_type& key - the key to which the value is assigned
+* @return constant reference to the mapped value inside the mapped file
+*/
+template <class key_type, class mapped_type, class compare>
+const mapped_type& my_map_view<key_type, mapped_type, compare>::at(const key_type& key) const
+{
+	const record* found = find(key);
+	if (found == nullptr)
+		throw my_exc(error_t::out_of_range);
+	return found->second;
+}
+
+/** Returns the record of the minimal key. Throws if the snapshot is empty.
+* @return constant reference to the record
+*/
+template <class key_type, class mapped_type, class compare>
+const typename my_map_view<key_type, mapped_type, compare>::record& my_map_view<key_type, mapped_type, compare>::min() const
+{
+	if (count == 0)
+		throw my_exc(error_t::empty_map);
+	return records[0];
+}
+
+/** Returns the record of the maximal key. Throws if the snapshot is empty.
+* @return constant reference to the record
+*/
+template <class key_type, class mapped_type, class compare>
+const typename my_map_view<key_type, mapped_type, compare>::record& my_map_view<key_type, mapped_type, compare>::max() const
+{
+	if (count == 0)
+		throw my_exc(error_t::empty_map);
+	return records[count - 1];
+}
+
+/** Verifies the checksums of all the blocks of records. Snapshots written without checksums are always reported as valid.
+* @return true if all the checksums match, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_map_view<key_type, mapped_type, compare>::verify() const
+{
+	if (not (header->flags & SNAPSHOT_CHECKSUMS))
+		return true;
+	const uint64_t* sums = reinterpret_cast<const uint64_t*>(file.data() + header->checksums_offset);
+	size_t per_block = static_cast<size_t>(header->records_per_block);
+	for (size_t first = 0, block = 0; first < count; first += per_block, ++block)
+	{
+		size_t length = std::min(per_block, count - first);
+		if (snapshot_checksum(records + first, length * sizeof(record)) != sums[block])
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,476 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "my_map.cpp"
+
+/** Read-only version of a my_persistent_map. Taking it costs O(1) - it only shares the root of the tree - and it stays valid and unchanged
+* however the map is modified afterwards, so long-running readers can iterate it while writers go on.
+* The nodes are immutable, kept balanced as an AVL tree, and have no parent pointers, so that they can be shared between versions.
+* A version may be read by many threads at once; the version itself must be obtained while no writer modifies the map.
+* @param key_type - the type used as the key
+* @param mapped_type - the type of data assigned to the keys
+* @param compare - the ordering of the keys, std::less<key_type> by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>>
+class persistent_snapshot
+{
+public:
+	using value_type = std::pair<key_type, mapped_type>;
+protected:
+	struct node
+	{
+		value_type data;
+		std::shared_ptr<const node> child[2];
+		int height;
+		node(const value_type& _data, std::shared_ptr<const node> left, std::shared_ptr<const node> right);
+	};
+	using node_ptr = std::shared_ptr<const node>;
+	/// Bound of the height of an AVL tree of at most 2^64 nodes.
+	static const unsigned max_height = 96;
+	node_ptr root;
+	size_t number_of_nodes;
+	compare key_compare;
+	static int height(const node_ptr& point) { return point == nullptr ? 0 : point->height; }
+	const node* find_node(const key_type& key) const;
+public:
+	persistent_snapshot() : number_of_nodes(0) {}
+
+	/// Forward iterator over the pairs in the ascending order of keys. Keeps the path from the root on its own fixed-size stack, so it never allocates.
+	/// It is valid as long as the version it has been obtained from exists.
+	class const_iterator
+	{
+		friend class persistent_snapshot;
+		const node* path[max_height];
+		unsigned depth;
+		void descend_left(const node* point)
+		{
+			for (; point != nullptr; point = point->child[LEFT].get())
+				path[depth++] = point;
+		}
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename persistent_snapshot::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+		const_iterator() : depth(0) {}
+		reference operator*() const { return path[depth - 1]->data; }
+		pointer operator->() const { return &path[depth - 1]->data; }
+		const_iterator& operator++()
+		{
+			const node* current = path[--depth];
+			descend_left(current->child[RIGHT].get());
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator previous = *this;
+			++*this;
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const
+		{
+			return depth == 0 ? other.depth == 0 : other.depth != 0 and path[depth - 1] == other.path[other.depth - 1];
+		}
+		bool operator!=(const const_iterator& other) const { return not (*this == other); }
+	};
+
+	size_t size() const { return number_of_nodes; }
+	bool empty() const { return root == nullptr; }
+	const_iterator begin() const;
+	const_iterator end() const { return const_iterator(); }
+	const_iterator lower_bound(const key_type& key) const;
+	const_iterator find(const key_type& key) const;
+	bool contains(const key_type& key) const { return find_node(key) != nullptr; }
+	size_t count(const key_type& key) const { return find_node(key) != nullptr ? 1 : 0; }
+	const mapped_type& at(const key_type& key) const;
+	const value_type& min() const;
+	const value_type& max() const;
+	template <class function_type>
+	void for_each_in_range(const key_type& low, const key_type& high, function_type function) const;
+	void serialize(const std::string& name) const;
+	std::future<serialize_report> serialize_async(const std::string& name) const;
+};
+
+/** Path-copying map: 'insert' and 'erase' never modify a node, they copy the O(log n) nodes on the path they touch and share the rest.
+* Thanks to that 'snapshot' returns an O(1) read-only version which is not affected by later modifications.
+* @param key_type - the type used as the key
+* @param mapped_type - the type of data assigned to the keys
+* @param compare - the ordering of the keys, std::less<key_type> by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>>
+class my_persistent_map : public persistent_snapshot<key_type, mapped_type, compare>
+{
+	using base = persistent_snapshot<key_type, mapped_type, compare>;
+public:
+	using value_type = typename base::value_type;
+	using snapshot_type = base;
+private:
+	using typename base::node;
+	using typename base::node_ptr;
+	using base::root;
+	using base::number_of_nodes;
+	using base::key_compare;
+	using base::height;
+	static node_ptr balance(const value_type& value, const node_ptr& left, const node_ptr& right);
+	node_ptr insert(const node_ptr& point, const value_type& value, bool& inserted) const;
+	node_ptr erase(const node_ptr& point, const key_type& key, bool& erased) const;
+	static node_ptr erase_min(const node_ptr& point, const node*& minimum);
+	template <class iterator_type>
+	static node_ptr build(iterator_type& first, size_t count);
+public:
+	/// Returns the present version of the map. It shares all the nodes, so the cost is O(1).
+	snapshot_type snapshot() const { return *this; }
+	void insert(const value_type& value);
+	void erase(const key_type& key);
+	void deserialize(const std::string& name);
+};
+
+/** Constructor of the node. The node is never modified afterwards, so its height is computed at once.
+* @param const std::pair<key_type, mapped_type>& _data - the pair stored in the node
+* @param std::shared_ptr<const node> left - the left subtree
+* @param std::shared_ptr<const node> right - the right subtree
+*/
+template <class key_type, class mapped_type, class compare>
+persistent_snapshot<key_type, mapped_type, compare>::node::node(const value_type& _data, std::shared_ptr<const node> left, std::shared_ptr<const node> right)
+	: data(_data), child{ std::move(left), std::move(right) }
+{
+	height = 1 + std::max(persistent_snapshot::height(child[LEFT]), persistent_snapshot::height(child[RIGHT]));
+}
+
+/** Looks for the node holding the key 'key'. No reference counts are touched during the descent.
+* @param const key_type& key - the key to be found
+* @return pointer to the node or nullptr if the key is not present
+*/
+template <class key_type, class mapped_type, class compare>
+auto persistent_snapshot<key_type, mapped_type, compare>::find_node(const key_type& key) const -> const node*
+{
+	const node* point = root.get();
+	while (point != nullptr)
+	{
+		if (key_compare(key, point->data.first))
+			point = point->child[LEFT].get();
+		else if (key_compare(point->data.first, key))
+			point = point->child[RIGHT].get();
+		else
+			return point;
+	}
+	return nullptr;
+}
+
+/** Returns the iterator to the pair of the least key.
+* @return the iterator to the first pair, equal to 'end' if the version is empty
+*/
+template <class key_type, class mapped_type, class compare>
+auto persistent_snapshot<key_type, mapped_type, compare>::begin() const -> const_iterator
+{
+	const_iterator first;
+	first.descend_left(root.get());
+	return first;
+}
+
+/** Returns the iterator to the first pair whose key is not less than 'key'.
+* @param const key_type& key - the bound
+* @return the iterator to the pair or 'end' if there is no such pair
+*/
+template <class key_type, class mapped_type, class compare>
+auto persistent_snapshot<key_type, mapped_type, compare>::lower_bound(const key_type& key) const -> const_iterator
+{
+	const_iterator bound;
+	const node* point = root.get();
+	while (point != nullptr)
+	{
+		if (key_compare(point->data.first, key))
+			point = point->child[RIGHT].get();
+		else
+		{
+			bound.path[bound.depth++] = point;
+			point = point->child[LEFT].get();
+		}
+	}
+	return bound;
+}
+
+/** Returns the iterator to the pair of the key 'key'.
+* @param const key_type& key - the key to be found
+* @return the iterator to the pair or 'end' if the key is not present
+*/
+template <class key_type, class mapped_type, class compare>
+auto persistent_snapshot<key_type, mapped_type, compare>::find(const key_type& key) const -> const_iterator
+{
+	const_iterator found = lower_bound(key);
+	if (found != end() and key_compare(key, found->first))
+		return end();
+	return found;
+}
+
+/** Accesses the value assigned to the key 'key'. Throws if such key is not present.
+* @param const key_type& key - the key to which the value is assigned
+* @return the value mapped to the key
+*/
+template <class key_type, class mapped_type, class compare>
+const mapped_type& persistent_snapshot<key_type, mapped_type, compare>::at(const key_type& key) const
+{
+	const node* point = find_node(key);
+	if (point == nullptr)
+		throw my_exc(root == nullptr ? error_t::empty_map : error_t::out_of_range);
+	return point->data.second;
+}
+
+/** Returns the pair of the least key. Throws if the version is empty.
+* @return the pair of the least key
+*/
+template <class key_type, class mapped_type, class compare>
+auto persistent_snapshot<key_type, mapped_type, compare>::min() const -> const value_type&
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	const node* point = root.get();
+	while (point->child[LEFT] != nullptr)
+		point = point->child[LEFT].get();
+	return point->data;
+}
+
+/** Returns the pair of the greatest key. Throws if the version is empty.
+* @return the pair of the greatest key
+*/
+template <class key_type, class mapped_type, class compare>
+auto persistent_snapshot<key_type, mapped_type, compare>::max() const -> const value_type&
+{
+	if (root == nullptr)
+		throw my_exc(error_t::empty_map);
+	const node* point = root.get();
+	while (point->child[RIGHT] != nullptr)
+		point = point->child[RIGHT].get();
+	return point->data;
+}
+
+/** Calls 'function' on every pair whose key lies in [low, high), in the ascending order of keys.
+* @param const key_type& low - the least key of the range
+* @param const key_type& high - the key past the range
+* @param function_type function - callable taking const std::pair<key_type, mapped_type>&
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+void persistent_snapshot<key_type, mapped_type, compare>::for_each_in_range(const key_type& low, const key_type& high, function_type function) const
+{
+	for (const_iterator point = lower_bound(low); point != end() and key_compare(point->first, high); ++point)
+		function(*point);
+}
+
+/** Serializes the version to the file 'name' in the format of my_map::serialize, the pairs in the ascending order of keys.
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void persistent_snapshot<key_type, mapped_type, compare>::serialize(const std::string& name) const
+{
+	std::ofstream file;
+	file.open(name, std::ios::out);
+	if (file.good())
+		for (const value_type& value : *this)
+			file << value.first << ' ' << value.second << '\n';
+	file.close();
+}
+
+/** Serializes the version to the file 'name' on a background thread, like 'serialize'. The capture only copies the version, in O(1),
+* so the map may be modified at once; the background thread holds the version until the file is written.
+* @param const std::string& name - the name of the file
+* @return the future of the report with the size of the file, the number of pairs and the times taken; it rethrows a failure of writing
+*/
+template <class key_type, class mapped_type, class compare>
+std::future<serialize_report> persistent_snapshot<key_type, mapped_type, compare>::serialize_async(const std::string& name) const
+{
+	auto begin = std::chrono::steady_clock::now();
+	persistent_snapshot version = *this;
+	double capture_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return std::async(std::launch::async, [name, version = std::move(version), capture_seconds]()
+		{
+			serialize_report report = write_pairs(name, version.begin(), version.end());
+			report.capture_seconds = capture_seconds;
+			return report;
+		});
+}
+
+/** Creates the node of the pair 'value' with the subtrees 'left' and 'right', whose heights differ by at most 2, restoring the AVL balance by a single or double rotation.
+* The rotations create new nodes, the subtrees themselves are shared.
+* @param const std::pair<key_type, mapped_type>& value - the pair of the node
+* @param const node_ptr& left - the left subtree
+* @param const node_ptr& right - the right subtree
+* @return the root of the balanced subtree
+*/
+template <class key_type, class mapped_type, class compare>
+auto my_persistent_map<key_type, mapped_type, compare>::balance(const value_type& value, const node_ptr& left, const node_ptr& right) -> node_ptr
+{
+	int left_height = height(left), right_height = height(right);
+	if (left_height > right_height + 1)
+	{
+		const node_ptr& outer = left->child[LEFT], & inner = left->child[RIGHT];
+		if (height(outer) >= height(inner))
+			return std::make_shared<const node>(left->data, outer, std::make_shared<const node>(value, inner, right));
+		return std::make_shared<const node>(inner->data,
+			std::make_shared<const node>(left->data, outer, inner->child[LEFT]),
+			std::make_shared<const node>(value, inner->child[RIGHT], right));
+	}
+	if (right_height > left_height + 1)
+	{
+		const node_ptr& outer = right->child[RIGHT], & inner = right->child[LEFT];
+		if (height(outer) >= height(inner))
+			return std::make_shared<const node>(right->data, std::make_shared<const node>(value, left, inner), outer);
+		return std::make_shared<const node>(inner->data,
+			std::make_shared<const node>(value, left, inner->child[LEFT]),
+			std::make_shared<const node>(right->data, inner->child[RIGHT], outer));
+	}
+	return std::make_shared<const node>(value, left, right);
+}
+
+/** Returns the subtree 'point' with the pair 'value' inserted. Only the nodes on the path to the new node are copied.
+* @param const node_ptr& point - the root of the subtree
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @param bool& inserted - set to false if the key is already present, in which case the subtree itself is returned
+* @return the root of the new subtree
+*/
+template <class key_type, class mapped_type, class compare>
+auto my_persistent_map<key_type, mapped_type, compare>::insert(const node_ptr& point, const value_type& value, bool& inserted) const -> node_ptr
+{
+	if (point == nullptr)
+		return std::make_shared<const node>(value, nullptr, nullptr);
+	if (key_compare(value.first, point->data.first))
+	{
+		node_ptr left = insert(point->child[LEFT], value, inserted);
+		return inserted ? balance(point->data, left, point->child[RIGHT]) : point;
+	}
+	if (key_compare(point->data.first, value.first))
+	{
+		node_ptr right = insert(point->child[RIGHT], value, inserted);
+		return inserted ? balance(point->data, point->child[LEFT], right) : point;
+	}
+	inserted = false;
+	return point;
+}
+
+/** Returns the subtree 'point' without its least node.
+* @param const node_ptr& point - the root of a non-empty subtree
+* @param const node*& minimum - receives the removed node, which stays alive as long as 'point' does
+* @return the root of the new subtree
+*/
+template <class key_type, class mapped_type, class compare>
+auto my_persistent_map<key_type, mapped_type, compare>::erase_min(const node_ptr& point, const node*& minimum) -> node_ptr
+{
+	if (point->child[LEFT] == nullptr)
+	{
+		minimum = point.get();
+		return point->child[RIGHT];
+	}
+	return balance(point->data, erase_min(point->child[LEFT], minimum), point->child[RIGHT]);
+}
+
+/** Returns the subtree 'point' without the pair of the key 'key'. Only the nodes on the path to the erased node
+* and to its successor are copied.
+* @param const node_ptr& point - the root of the subtree
+* @param const key_type& key - the key of the pair to be erased
+* @param bool& erased - set to true if the key has been found
+* @return the root of the new subtree
+*/
+template <class key_type, class mapped_type, class compare>
+auto my_persistent_map<key_type, mapped_type, compare>::erase(const node_ptr& point, const key_type& key, bool& erased) const -> node_ptr
+{
+	if (point == nullptr)
+		return point;
+	if (key_compare(key, point->data.first))
+	{
+		node_ptr left = erase(point->child[LEFT], key, erased);
+		return erased ? balance(point->data, left, point->child[RIGHT]) : point;
+	}
+	if (key_compare(point->data.first, key))
+	{
+		node_ptr right = erase(point->child[RIGHT], key, erased);
+		return erased ? balance(point->data, point->child[LEFT], right) : point;
+	}
+	erased = true;
+	if (point->child[LEFT] == nullptr)
+		return point->child[RIGHT];
+	if (point->child[RIGHT] == nullptr)
+		return point->child[LEFT];
+	const node* successor = nullptr;
+	node_ptr right = erase_min(point->child[RIGHT], successor);
+	return balance(successor->data, point->child[LEFT], right);
+}
+
+/** Builds a perfectly balanced subtree of 'count' consecutive pairs starting at 'first'.
+* @param iterator_type& first - the iterator to the first pair of the subtree, advanced past its last pair
+* @param size_t count - the number of pairs in the subtree
+* @return the root of the subtree
+*/
+template <class key_type, class mapped_type, class compare>
+template <class iterator_type>
+auto my_persistent_map<key_type, mapped_type, compare>::build(iterator_type& first, size_t count) -> node_ptr
+{
+	if (count == 0)
+		return nullptr;
+	node_ptr left = build(first, count / 2);
+	const value_type& value = *first++;
+	node_ptr right = build(first, count - count / 2 - 1);
+	return std::make_shared<const node>(value, std::move(left), std::move(right));
+}
+
+/** Performs insertion into the map. The versions returned by 'snapshot' before are not affected.
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_persistent_map<key_type, mapped_type, compare>::insert(const value_type& value)
+{
+	bool inserted = true;
+	root = insert(root, value, inserted);
+	if (inserted)
+		++number_of_nodes;
+}
+
+/** Erases the pair of key 'key' if such is present in the map. The versions returned by 'snapshot' before are not affected;
+* the nodes no longer used by any version are released.
+* @param const key_type& key - the key of the pair to be erased
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_persistent_map<key_type, mapped_type, compare>::erase(const key_type& key)
+{
+	bool erased = false;
+	root = erase(root, key, erased);
+	if (erased)
+		--number_of_nodes;
+}
+
+/** Deserializes the contents of the file 'name', written by 'serialize', replacing the contents of the map.
+* The pairs are sorted and the tree is built in linear time. Of equal keys the first one is kept.
+* @param const std::string& name - the name of the file
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_persistent_map<key_type, mapped_type, compare>::deserialize(const std::string& name)
+{
+	std::vector<value_type> values;
+	if (read_text_pairs(name, values))
+	{
+		auto less = [this](const value_type& a, const value_type& b) { return key_compare(a.first, b.first); };
+		std::stable_sort(values.begin(), values.end(), less);
+		values.erase(std::unique(values.begin(), values.end(), [this](const value_type& a, const value_type& b)
+			{
+				return not key_compare(a.first, b.first) and not key_compare(b.first, a.first);
+			}), values.end());
+		auto first = values.cbegin();
+		root = build(first, values.size());
+		number_of_nodes = values.size();
+	}
+}
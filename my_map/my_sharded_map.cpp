@@ -0,0 +1,510 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "my_concurrent_map.cpp"
+#include "my_map.cpp"
+
+/// Settings of the automatic reshaping of my_sharded_map.
+struct sharding_options
+{
+	/// The size of a shard above which it is split in two at its median key; zero disables automatic splits.
+	size_t split_size = size_t(1) << 20;
+	/// The size of a shard below which 'erase' merges it with its smaller neighbour, unless together they would exceed half of 'split_size';
+	/// zero, the default, keeps the shards however small, so that a partition chosen up front for the writers survives.
+	size_t merge_size = 0;
+};
+
+/** Map partitioned by ranges of keys into shards, each an instance of my_map guarded by its own lock, so that writers of different ranges
+* proceed in parallel. Shard i holds the keys in [bounds[i - 1], bounds[i]). The bounds are chosen from a sample of keys up front and
+* changed online: a shard that grows past 'split_size' is split in two at its median and a shard that shrinks below 'merge_size' is joined
+* with a neighbour, by 'split' and 'join' of my_map; the pairs that change shards are copied, since every shard needs a node pool of its own.
+* Operations announce themselves in a read indicator instead of taking a common lock, so the shards are the only points of contention;
+* a reshaping raises a flag, waits until no operation is left and then owns every shard.
+* Since the ranges are disjoint and ordered, the ordered traversal is the concatenation of the shards in the order of the bounds,
+* and a range scan visits only the shards overlapping the range.
+* @param key_type - the type used as the key, copyable
+* @param mapped_type - the type of data assigned to the keys
+* @param compare - the ordering of the keys, std::less<key_type> by default
+*/
+template <class key_type, class mapped_type, class compare = std::less<key_type>>
+class my_sharded_map
+{
+public:
+	using map_type = my_map<key_type, mapped_type, compare>;
+	using value_type = typename map_type::value_type;
+private:
+	/// One range of the keys; aligned to a cache line, so that the locks of neighbouring shards are not falsely shared.
+	struct alignas(64) shard
+	{
+		mutable std::shared_mutex lock;
+		map_type map;
+	};
+	std::vector<std::unique_ptr<shard>> shards;
+	std::vector<key_type> bounds;
+	compare key_compare;
+	sharding_options options;
+	mutable read_indicator present;
+	std::atomic<bool> reshaping{ false };
+	mutable std::mutex layout;
+	template <class function_type>
+	auto enter(function_type function) const -> decltype(function());
+	template <class function_type>
+	void reshape(function_type function);
+	size_t shard_of(const key_type& key) const;
+	void split_shard(size_t index);
+	void merge_shards(size_t index);
+	void split_oversized(const key_type& key);
+	void merge_undersized(const key_type& key);
+public:
+	explicit my_sharded_map(const sharding_options& _options = sharding_options());
+	template <class iterator_type>
+	my_sharded_map(iterator_type first, iterator_type last, size_t number_of_shards, const sharding_options& _options = sharding_options());
+	my_sharded_map(const my_sharded_map&) = delete;
+	my_sharded_map& operator=(const my_sharded_map&) = delete;
+
+	bool insert(const value_type& value);
+	template <class value_argument>
+	bool insert_or_assign(const key_type& key, value_argument&& value);
+	bool erase(const key_type& key);
+	bool find(const key_type& key, mapped_type& value) const;
+	bool contains(const key_type& key) const;
+	mapped_type at(const key_type& key) const;
+	value_type min() const;
+	value_type max() const;
+	size_t size() const;
+	bool empty() const;
+	size_t number_of_shards() const;
+	template <class function_type>
+	void for_each(function_type function) const;
+	template <class function_type>
+	void for_each_in_range(const key_type& low, const key_type& high, function_type function) const;
+	void rebalance();
+};
+
+/** Constructor of class my_sharded_map<key_type, mapped_type, compare> starting with a single shard.
+* Without a sample the bounds are unknown, so all the keys go to one shard until it grows past 'split_size'.
+* @param const sharding_options& _options - the thresholds of the automatic reshaping
+*/
+template <class key_type, class mapped_type, class compare>
+my_sharded_map<key_type, mapped_type, compare>::my_sharded_map(const sharding_options& _options) : options(_options)
+{
+	shards.push_back(std::make_unique<shard>());
+}
+
+/** Constructor of class my_sharded_map<key_type, mapped_type, compare> choosing the bounds of 'number_of_shards' shards as the quantiles of a sample of keys.
+* The sample should be drawn from the keys expected to be written; duplicates are allowed and may leave fewer shards.
+* @param iterator_type first - the iterator to the first key of the sample
+* @param iterator_type last - the iterator past the last key of the sample
+* @param size_t number_of_shards - the number of shards wanted, typically the number of writing threads or a small multiple of it
+* @param const sharding_options& _options - the thresholds of the automatic reshaping
+*/
+template <class key_type, class mapped_type, class compare>
+template <class iterator_type>
+my_sharded_map<key_type, mapped_type, compare>::my_sharded_map(iterator_type first, iterator_type last, size_t number_of_shards, const sharding_options& _options) : options(_options)
+{
+	std::vector<key_type> sample(first, last);
+	std::sort(sample.begin(), sample.end(), key_compare);
+	for (size_t i = 1; i < number_of_shards and not sample.empty(); ++i)
+	{
+		const key_type& bound = sample[i * sample.size() / number_of_shards];
+		if (bounds.empty() or key_compare(bounds.back(), bound))
+			bounds.push_back(bound);
+	}
+	for (size_t i = 0; i <= bounds.size(); ++i)
+		shards.push_back(std::make_unique<shard>());
+}
+
+/** Runs 'function' while the layout of the shards cannot change. Never takes a common lock: the caller marks its presence in the read indicator,
+* and only if a reshaping is under way it steps back and waits for it to end.
+* @param function_type function - callable taking no arguments
+* @return the result of 'function'
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+auto my_sharded_map<key_type, mapped_type, compare>::enter(function_type function) const -> decltype(function())
+{
+	struct presence
+	{
+		read_indicator& indicator;
+		size_t slot;
+		presence(read_indicator& _indicator) : indicator(_indicator), slot(read_indicator::slot()) { indicator.arrive(slot); }
+		~presence() { indicator.depart(slot); }
+	};
+	for (;;)
+	{
+		{
+			presence guard(present);
+			if (not reshaping.load())
+				return function();
+		}
+		std::lock_guard<std::mutex> wait(layout);
+	}
+}
+
+/** Runs 'function' with exclusive access to the layout and to every shard: announces the reshaping and waits until no operation is left.
+* Reshapings are serialized; they must not be started from within 'enter'.
+* @param function_type function - callable taking no arguments
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+void my_sharded_map<key_type, mapped_type, compare>::reshape(function_type function)
+{
+	std::lock_guard<std::mutex> lock(layout);
+	struct announcement
+	{
+		std::atomic<bool>& flag;
+		announcement(std::atomic<bool>& _flag) : flag(_flag) { flag.store(true); }
+		~announcement() { flag.store(false); }
+	} guard(reshaping);
+	while (not present.empty())
+		std::this_thread::yield();
+	function();
+}
+
+/** Gives the index of the shard whose range contains 'key'. The layout must not change meanwhile.
+* @param const key_type& key - the key
+* @return the index into 'shards'
+*/
+template <class key_type, class mapped_type, class compare>
+size_t my_sharded_map<key_type, mapped_type, compare>::shard_of(const key_type& key) const
+{
+	return size_t(std::upper_bound(bounds.begin(), bounds.end(), key, key_compare) - bounds.begin());
+}
+
+/** Splits the shard of index 'index' at its median key into two shards, in O(n) for the walk to the median and the copy of the greater half. Requires exclusive access.
+* @param size_t index - the index of the shard
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_sharded_map<key_type, mapped_type, compare>::split_shard(size_t index)
+{
+	map_type& map = shards[index]->map;
+	if (map.size() < 2)
+		return;
+	key_type median = std::next(map.cbegin(), std::ptrdiff_t(map.size() / 2))->first;
+	map_type upper = map.split(median);
+	// 'split' leaves both halves in one node pool, which the writers of two shards must not share; 'join' moves the pairs into a pool of their own.
+	auto greater = std::make_unique<shard>();
+	greater->map.join(std::move(upper));
+	shards.insert(shards.begin() + std::ptrdiff_t(index) + 1, std::move(greater));
+	bounds.insert(bounds.begin() + std::ptrdiff_t(index), median);
+}
+
+/** Joins the shard of index 'index + 1' to the shard of index 'index', copying its pairs into the node pool of the lesser one. Requires exclusive access.
+* @param size_t index - the index of the lesser shard
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_sharded_map<key_type, mapped_type, compare>::merge_shards(size_t index)
+{
+	shards[index]->map.join(std::move(shards[index + 1]->map));
+	shards.erase(shards.begin() + std::ptrdiff_t(index) + 1);
+	bounds.erase(bounds.begin() + std::ptrdiff_t(index));
+}
+
+/** Splits the shard of 'key' in halves until each is within 'split_size'. Checks the size again, since other writers may have got there first.
+* @param const key_type& key - the key just inserted
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_sharded_map<key_type, mapped_type, compare>::split_oversized(const key_type& key)
+{
+	reshape([&]()
+		{
+			for (size_t index = shard_of(key); shards[index]->map.size() > options.split_size; index = shard_of(key))
+				split_shard(index);
+		});
+}
+
+/** Joins the shard of 'key' with its smaller neighbour if it is still below 'merge_size' and the two fit in half of 'split_size'.
+* @param const key_type& key - the key just erased
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_sharded_map<key_type, mapped_type, compare>::merge_undersized(const key_type& key)
+{
+	reshape([&]()
+		{
+			size_t index = shard_of(key);
+			if (shards.size() < 2 or shards[index]->map.size() >= options.merge_size)
+				return;
+			size_t lesser = index;
+			if (index + 1 == shards.size() or (index > 0 and shards[index - 1]->map.size() < shards[index + 1]->map.size()))
+				lesser = index - 1;
+			size_t together = shards[lesser]->map.size() + shards[lesser + 1]->map.size();
+			if (options.split_size == 0 or together <= options.split_size / 2)
+				merge_shards(lesser);
+		});
+}
+
+/** Performs insertion into the map unless the key is present. Locks the shard of the key only; splits it afterwards if it has grown past 'split_size'.
+* @param const std::pair<key_type, mapped_type>& value - the pair to be inserted
+* @return true if the pair was inserted, false if the key was present
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_sharded_map<key_type, mapped_type, compare>::insert(const value_type& value)
+{
+	bool inserted = false, oversized = false;
+	enter([&]()
+		{
+			shard& part = *shards[shard_of(value.first)];
+			std::unique_lock<std::shared_mutex> lock(part.lock);
+			inserted = part.map.insert(value).second;
+			oversized = (options.split_size != 0 and part.map.size() > options.split_size);
+		});
+	if (oversized)
+		split_oversized(value.first);
+	return inserted;
+}
+
+/** Inserts the pair of 'key' and 'value', or assigns 'value' to 'key' if it is present. Locks the shard of the key only.
+* @param const key_type& key - the key
+* @param value_argument&& value - the value to be inserted or assigned
+* @return true if the pair was inserted, false if the value was assigned
+*/
+template <class key_type, class mapped_type, class compare>
+template <class value_argument>
+bool my_sharded_map<key_type, mapped_type, compare>::insert_or_assign(const key_type& key, value_argument&& value)
+{
+	bool inserted = false, oversized = false;
+	enter([&]()
+		{
+			shard& part = *shards[shard_of(key)];
+			std::unique_lock<std::shared_mutex> lock(part.lock);
+			inserted = part.map.insert_or_assign(key, std::forward<value_argument>(value)).second;
+			oversized = (options.split_size != 0 and part.map.size() > options.split_size);
+		});
+	if (oversized)
+		split_oversized(key);
+	return inserted;
+}
+
+/** Erases the pair of key 'key' if such is present. Locks the shard of the key only; merges it afterwards if it has shrunk below 'merge_size'.
+* @param const key_type& key - the key of the pair to be erased
+* @return true if the pair was erased, false if the key was not present
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_sharded_map<key_type, mapped_type, compare>::erase(const key_type& key)
+{
+	bool erased = false, undersized = false;
+	enter([&]()
+		{
+			shard& part = *shards[shard_of(key)];
+			std::unique_lock<std::shared_mutex> lock(part.lock);
+			erased = not part.map.extract(key).empty();
+			undersized = (erased and shards.size() > 1 and part.map.size() < options.merge_size);
+		});
+	if (undersized)
+		merge_undersized(key);
+	return erased;
+}
+
+/** Looks for the key 'key' and copies its mapped value. Never throws on a miss.
+* @param const key_type& key - the key to be found
+* @param mapped_type& value - receives the mapped value if the key is present
+* @return true if the key is present, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_sharded_map<key_type, mapped_type, compare>::find(const key_type& key, mapped_type& value) const
+{
+	return enter([&]()
+		{
+			const shard& part = *shards[shard_of(key)];
+			std::shared_lock<std::shared_mutex> lock(part.lock);
+			auto found = part.map.find(key);
+			if (found == part.map.end())
+				return false;
+			value = found->second;
+			return true;
+		});
+}
+
+/** Checks whether the key 'key' is present in the map.
+* @param const key_type& key - the key to be checked
+* @return true if the key is present, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_sharded_map<key_type, mapped_type, compare>::contains(const key_type& key) const
+{
+	return enter([&]()
+		{
+			const shard& part = *shards[shard_of(key)];
+			std::shared_lock<std::shared_mutex> lock(part.lock);
+			return part.map.contains(key);
+		});
+}
+
+/** Returns a copy of the value assigned to key 'key'. Throws if such key is not present.
+* @param const key_type& key - the key to which the value is assigned
+* @return the value mapped to the key
+*/
+template <class key_type, class mapped_type, class compare>
+mapped_type my_sharded_map<key_type, mapped_type, compare>::at(const key_type& key) const
+{
+	return enter([&]()
+		{
+			const shard& part = *shards[shard_of(key)];
+			std::shared_lock<std::shared_mutex> lock(part.lock);
+			return part.map.at(key);
+		});
+}
+
+/** Returns a copy of the pair of the least key, found in the first non-empty shard. Throws if the map is empty.
+* @return the pair of the least key
+*/
+template <class key_type, class mapped_type, class compare>
+typename my_sharded_map<key_type, mapped_type, compare>::value_type my_sharded_map<key_type, mapped_type, compare>::min() const
+{
+	return enter([&]()
+		{
+			for (const std::unique_ptr<shard>& part : shards)
+			{
+				std::shared_lock<std::shared_mutex> lock(part->lock);
+				if (not part->map.empty())
+					return part->map.min();
+			}
+			throw my_exc(error_t::empty_map);
+		});
+}
+
+/** Returns a copy of the pair of the greatest key, found in the last non-empty shard. Throws if the map is empty.
+* @return the pair of the greatest key
+*/
+template <class key_type, class mapped_type, class compare>
+typename my_sharded_map<key_type, mapped_type, compare>::value_type my_sharded_map<key_type, mapped_type, compare>::max() const
+{
+	return enter([&]()
+		{
+			for (auto part = shards.rbegin(); part != shards.rend(); ++part)
+			{
+				std::shared_lock<std::shared_mutex> lock((*part)->lock);
+				if (not (*part)->map.empty())
+					return (*part)->map.max();
+			}
+			throw my_exc(error_t::empty_map);
+		});
+}
+
+/** Returns the number of pairs, summed over the shards one at a time, so it is exact only if there are no concurrent writers.
+* @return the number of pairs
+*/
+template <class key_type, class mapped_type, class compare>
+size_t my_sharded_map<key_type, mapped_type, compare>::size() const
+{
+	return enter([&]()
+		{
+			size_t total = 0;
+			for (const std::unique_ptr<shard>& part : shards)
+			{
+				std::shared_lock<std::shared_mutex> lock(part->lock);
+				total += part->map.size();
+			}
+			return total;
+		});
+}
+
+/** Returns the information whether the map is empty.
+* @return true if the map is empty, false otherwise
+*/
+template <class key_type, class mapped_type, class compare>
+bool my_sharded_map<key_type, mapped_type, compare>::empty() const
+{
+	return enter([&]()
+		{
+			for (const std::unique_ptr<shard>& part : shards)
+			{
+				std::shared_lock<std::shared_mutex> lock(part->lock);
+				if (not part->map.empty())
+					return false;
+			}
+			return true;
+		});
+}
+
+/** Returns the current number of shards.
+* @return the number of shards
+*/
+template <class key_type, class mapped_type, class compare>
+size_t my_sharded_map<key_type, mapped_type, compare>::number_of_shards() const
+{
+	return enter([&]() { return shards.size(); });
+}
+
+/** Calls 'function' on every pair in the ascending order of keys, shard after shard. Each shard is read under its own lock,
+* so the traversal is consistent within a shard but not across shards while writers run; the layout does not change meanwhile.
+* @param function_type function - callable taking const std::pair<key_type, mapped_type>&; it must not modify this map
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+void my_sharded_map<key_type, mapped_type, compare>::for_each(function_type function) const
+{
+	enter([&]()
+		{
+			for (const std::unique_ptr<shard>& part : shards)
+			{
+				std::shared_lock<std::shared_mutex> lock(part->lock);
+				for (const value_type& pair : part->map)
+					function(pair);
+			}
+		});
+}
+
+/** Calls 'function' on every pair whose key lies in [low, high), in the ascending order of keys. Only the shards overlapping the range are locked and visited.
+* @param const key_type& low - the least key of the range
+* @param const key_type& high - the key past the range
+* @param function_type function - callable taking const std::pair<key_type, mapped_type>&; it must not modify this map
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+template <class function_type>
+void my_sharded_map<key_type, mapped_type, compare>::for_each_in_range(const key_type& low, const key_type& high, function_type function) const
+{
+	if (not key_compare(low, high))
+		return;
+	enter([&]()
+		{
+			for (size_t index = shard_of(low); index < shards.size() and (index == 0 or key_compare(bounds[index - 1], high)); ++index)
+			{
+				std::shared_lock<std::shared_mutex> lock(shards[index]->lock);
+				shards[index]->map.for_each_in_range(low, high, function);
+			}
+		});
+}
+
+/** Splits every shard larger than 'split_size' and merges neighbours smaller than 'merge_size', as 'insert' and 'erase' would, in one reshaping.
+* Useful after bulk loads or when 'merge_size' has been left at zero. Runs concurrently with the other operations, which wait while it works.
+* @return void
+*/
+template <class key_type, class mapped_type, class compare>
+void my_sharded_map<key_type, mapped_type, compare>::rebalance()
+{
+	reshape([&]()
+		{
+			for (size_t index = 0; index < shards.size(); )
+			{
+				if (options.split_size != 0 and shards[index]->map.size() > options.split_size)
+					split_shard(index);
+				else
+					++index;
+			}
+			for (size_t index = 0; index + 1 < shards.size(); )
+			{
+				size_t together = shards[index]->map.size() + shards[index + 1]->map.size();
+				bool small = shards[index]->map.size() < options.merge_size or shards[index + 1]->map.size() < options.merge_size;
+				if (small and (options.split_size == 0 or together <= options.split_size / 2))
+					merge_shards(index);
+				else
+					++index;
+			}
+		});
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+/// The pools of the pool_allocators rebound from one another, by object type; an entry expires when the last allocator of its type is gone.
+struct pool_family
+{
+	std::unordered_map<std::type_index, std::weak_ptr<void>> pools;
+};
+
+/** Slab allocator for node-based containers. Single objects are carved out of slabs of 'slots_per_slab' slots
+* and freed slots are kept on an intrusive free list, so that insertion after erasure reuses memory without calling
+* the global operator new. Requests for more than one object are forwarded to the global operator new.
+* Copies of an allocator share the same pool and compare equal. Allocators rebound from one another form a family holding one pool
+* per type, so that e.g. all the maps constructed from copies of one allocator take their nodes from the same pool and can pass nodes
+* to one another; a default-constructed allocator starts a family of its own, and so does the allocator of a container copy-constructed from another.
+* The pool is not synchronised - a single pool must not be used from several threads at the same time.
+* @param T - the type of the allocated objects
+* @param slots_per_slab - the number of objects in a single slab
+*/
+template <class T, size_t slots_per_slab = 256>
+class pool_allocator
+{
+	template <class, size_t> friend class pool_allocator;
+
+	/// A free slot holds the link to the next free slot, a used one holds the object.
+	union slot
+	{
+		slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+	/// A slab of slots; slabs are chained so that they can be released together.
+	struct slab
+	{
+		slab* next;
+		slot slots[slots_per_slab];
+	};
+	/// The state shared by all the copies of an allocator.
+	struct pool
+	{
+		slab* slabs = nullptr;
+		slot* free_list = nullptr;
+		size_t number_of_slabs = 0, slots_in_use = 0;
+		pool() = default;
+		pool(const pool&) = delete;
+		pool& operator=(const pool&) = delete;
+		~pool()
+		{
+			while (slabs != nullptr)
+			{
+				slab* next = slabs->next;
+				delete slabs;
+				slabs = next;
+			}
+		}
+	};
+	std::shared_ptr<pool_family> my_family;
+	std::shared_ptr<pool> my_pool;
+	static std::shared_ptr<pool> pool_in(pool_family& relatives);
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::false_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+	using is_always_equal = std::false_type;
+	template <class U> struct rebind { using other = pool_allocator<U, slots_per_slab>; };
+
+	pool_allocator() : my_family(std::make_shared<pool_family>()), my_pool(pool_in(*my_family)) {}
+	pool_allocator(const pool_allocator& other) = default;
+	/// Rebinding constructor. Slots of different types differ in size, so the new allocator uses the pool of its family for type T.
+	template <class U>
+	pool_allocator(const pool_allocator<U, slots_per_slab>& other) : my_family(other.my_family), my_pool(pool_in(*my_family)) {}
+	pool_allocator& operator=(const pool_allocator& other) = default;
+	/// Gives the allocator of a copy of a container: a new pool, so that the copy does not share the slabs of the original.
+	pool_allocator select_on_container_copy_construction() const { return pool_allocator(); }
+
+	T* allocate(size_t n);
+	void deallocate(T* pointer, size_t n);
+	bool release();
+
+	/// Returns the number of objects currently allocated from the pool.
+	size_t slots_in_use() const { return my_pool->slots_in_use; }
+	/// Returns the number of bytes reserved by the pool for all its slabs.
+	size_t bytes_reserved() const { return my_pool->number_of_slabs * sizeof(slab); }
+	/// Returns the number of bytes a single allocated object occupies in the pool.
+	static constexpr size_t slot_size() { return sizeof(slot); }
+
+	template <class U>
+	bool operator==(const pool_allocator<U, slots_per_slab>& other) const { return my_pool == other.my_pool; }
+	template <class U>
+	bool operator!=(const pool_allocator<U, slots_per_slab>& other) const { return my_pool != other.my_pool; }
+};
+
+/** Returns the pool of 'relatives' for type T, creating it if no allocator of the family uses one.
+* @param pool_family& relatives - the family of the allocator
+* @return the shared pointer to the pool
+*/
+template <class T, size_t slots_per_slab>
+std::shared_ptr<typename pool_allocator<T, slots_per_slab>::pool> pool_allocator<T, slots_per_slab>::pool_in(pool_family& relatives)
+{
+	std::weak_ptr<void>& entry = relatives.pools[std::type_index(typeid(T))];
+	std::shared_ptr<pool> found = std::static_pointer_cast<pool>(entry.lock());
+	if (found == nullptr)
+	{
+		found = std::make_shared<pool>();
+		entry = found;
+	}
+	return found;
+}
+
+/** Allocates memory for 'n' objects of type T. A single object is taken from the free list or from a new slab.
+* @param size_t n - the number of objects
+* @return pointer to the uninitialised memory
+*/
+template <class T, size_t slots_per_slab>
+T* pool_allocator<T, slots_per_slab>::allocate(size_t n)
+{
+	if (n != 1)
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+	pool& state = *my_pool;
+	if (state.free_list == nullptr)
+	{
+		slab* fresh = new slab;
+		fresh->next = state.slabs;
+		state.slabs = fresh;
+		++state.number_of_slabs;
+		for (size_t i = slots_per_slab; i-- > 0; )
+		{
+			fresh->slots[i].next = state.free_list;
+			state.free_list = &fresh->slots[i];
+		}
+	}
+	slot* taken = state.free_list;
+	state.free_list = taken->next;
+	++state.slots_in_use;
+	return reinterpret_cast<T*>(taken->storage);
+}
+
+/** Returns memory obtained from 'allocate'. A single slot is put back on the free list, so it is reused by the next allocation.
+* @param T* pointer - the memory to be returned
+* @param size_t n - the number of objects passed to 'allocate'
+* @return void
+*/
+template <class T, size_t slots_per_slab>
+void pool_allocator<T, slots_per_slab>::deallocate(T* pointer, size_t n)
+{
+	if (n != 1)
+	{
+		::operator delete(pointer, std::align_val_t(alignof(T)));
+		return;
+	}
+	pool& state = *my_pool;
+	slot* released = reinterpret_cast<slot*>(pointer);
+	released->next = state.free_list;
+	state.free_list = released;
+	--state.slots_in_use;
+}
+
+/** Frees all the slabs of the pool at once, together with every object still allocated from it, which must need no destruction.
+* Declines if other allocators share the pool, since their objects would go as well.
+* @return true if the pool has been emptied, false if it is shared
+*/
+template <class T, size_t slots_per_slab>
+bool pool_allocator<T, slots_per_slab>::release()
+{
+	if (my_pool.use_count() != 1)
+		return false;
+	my_pool.reset();
+	my_pool = pool_in(*my_family);
+	return true;
+}